@@ -0,0 +1,19 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(constant_id = 0) const uint numTextures = 1;
+
+layout(set = 0, binding = 0) uniform sampler2D textures[numTextures];
+
+layout(push_constant) uniform PushConstants {
+    layout(offset = 128) uint textureIndex;
+} pc;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(textures[pc.textureIndex], fragTexCoord);
+}
@@ -16,6 +16,7 @@
 *  THE SOFTWARE.
 */
 
+#include <algorithm>
 #include <fcntl.h>
 #include <iostream>
 #include <stdio.h>
@@ -95,6 +96,34 @@ std::vector<std::string> listNetworkConnections()
     return ifr_names;
 }
 
+uint32_t getNetworkMTU(const std::string& ifrName)
+{
+    uint32_t mtu = 0;
+
+#if (!defined(WIN32) || defined(__CYGWIN__)) && defined(SIOCGIFMTU)
+    int socketfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (socketfd == -1)
+    {
+        return 0;
+    }
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifrName.c_str(), sizeof(ifr.ifr_name) - 1);
+
+    if (ioctl(socketfd, SIOCGIFMTU, &ifr) != -1 && ifr.ifr_mtu > 0)
+    {
+        mtu = static_cast<uint32_t>(ifr.ifr_mtu);
+    }
+
+    close(socketfd);
+#else
+    (void)ifrName;
+#endif
+
+    return mtu;
+}
+
 Broadcaster::Broadcaster(const std::string& hostname, uint16_t port, const std::string& ifrName) :
     _ifr_name(ifrName),
     _initialized(false),
@@ -148,6 +177,20 @@ Broadcaster::~Broadcaster(void)
 #endif
 }
 
+bool Broadcaster::isMulticast() const
+{
+    return IN_MULTICAST(ntohl(static_cast<uint32_t>(_address)));
+}
+
+uint32_t Broadcaster::mtu() const
+{
+#if defined(__linux)
+    // unicast or broadcast to the local host goes via the loopback interface
+    if ((ntohl(static_cast<uint32_t>(_address)) >> 24) == 127) return getNetworkMTU("lo");
+#endif
+    return getNetworkMTU(_ifr_name);
+}
+
 bool Broadcaster::init(void)
 {
     if (_port == 0)
@@ -162,12 +205,15 @@ bool Broadcaster::init(void)
         return false;
     }
 
+    // SO_BROADCAST is also enabled when a host is specified so that directed broadcast addresses, such as 127.255.255.255, can be used.
 #if defined(WIN32) && !defined(__CYGWIN__)
     const BOOL on = TRUE;
     setsockopt(_so, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(int));
+    setsockopt(_so, SOL_SOCKET, SO_BROADCAST, (const char*)&on, sizeof(int));
 #else
     int on = 1;
     setsockopt(_so, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(_so, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
 #endif
 
     saddr.sin_family = AF_INET;
@@ -175,15 +221,32 @@ bool Broadcaster::init(void)
     if (_address != 0)
     {
         saddr.sin_addr.s_addr = _address;
+
+        if (isMulticast())
+        {
+            // limit how far multicast packets propagate, and whether recievers on this host also get them
+            unsigned char loopback = _multicastLoopback ? 1 : 0;
+            setsockopt(_so, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&_multicastTTL, sizeof(_multicastTTL));
+            setsockopt(_so, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*)&loopback, sizeof(loopback));
+
+#if !defined(WIN32) || defined(__CYGWIN__)
+            // send via the requested network interface rather than the default route
+            struct ifreq ifr;
+            memset(&ifr, 0, sizeof(ifr));
+            strncpy(ifr.ifr_name, _ifr_name.c_str(), sizeof(ifr.ifr_name) - 1);
+            if (ioctl(_so, SIOCGIFADDR, &ifr) >= 0)
+            {
+                struct in_addr interfaceAddress = ((sockaddr_in*)&ifr.ifr_addr)->sin_addr;
+                setsockopt(_so, IPPROTO_IP, IP_MULTICAST_IF, &interfaceAddress, sizeof(interfaceAddress));
+            }
+#endif
+        }
     }
     else
     {
 #if defined(WIN32) && !defined(__CYGWIN__)
-        setsockopt(_so, SOL_SOCKET, SO_BROADCAST, (const char*)&on, sizeof(int));
         saddr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
 #else
-        setsockopt(_so, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
-
         struct ifreq ifr;
         strcpy(ifr.ifr_name, _ifr_name.c_str());
 
@@ -259,3 +322,65 @@ void Broadcaster::broadcast(const void* buffer, unsigned int buffer_size)
 
 #endif
 }
+
+void Broadcaster::broadcast(const std::vector<Datagram>& datagrams)
+{
+    if (!_initialized) init();
+
+    if (datagrams.empty()) return;
+
+#if defined(__linux)
+
+    // send the datagrams in batches, each datagram's header and data are passed as separate iovec so no copy is required
+    const std::size_t maxBatchSize = 64;
+
+    struct mmsghdr msgs[maxBatchSize];
+    struct iovec iovecs[maxBatchSize][2];
+
+    std::size_t i = 0;
+    while (i < datagrams.size())
+    {
+        std::size_t batchSize = std::min(maxBatchSize, datagrams.size() - i);
+
+        memset(msgs, 0, sizeof(struct mmsghdr) * batchSize);
+        for (std::size_t j = 0; j < batchSize; ++j)
+        {
+            auto& datagram = datagrams[i + j];
+            iovecs[j][0].iov_base = const_cast<void*>(datagram.header);
+            iovecs[j][0].iov_len = datagram.headerSize;
+            iovecs[j][1].iov_base = const_cast<void*>(datagram.data);
+            iovecs[j][1].iov_len = datagram.dataSize;
+
+            msgs[j].msg_hdr.msg_name = &saddr;
+            msgs[j].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            msgs[j].msg_hdr.msg_iov = iovecs[j];
+            msgs[j].msg_hdr.msg_iovlen = 2;
+        }
+
+        int result = sendmmsg(_so, msgs, static_cast<unsigned int>(batchSize), 0);
+        if (result < 0)
+        {
+            if (errno == EINTR) continue;
+
+            std::cerr << "Broadcaster::broadcast() - errno = " << errno << ", error : " << strerror(errno) << std::endl;
+            return;
+        }
+
+        // sendmmsg() may send fewer than requested, so advance by the number actually sent and retry the remainder
+        i += static_cast<std::size_t>(result);
+    }
+
+#else
+
+    // no batched send available so fall back to sending each datagram individually via a scratch buffer
+    std::vector<uint8_t> buffer;
+    for (auto& datagram : datagrams)
+    {
+        buffer.resize(datagram.headerSize + datagram.dataSize);
+        memcpy(buffer.data(), datagram.header, datagram.headerSize);
+        memcpy(buffer.data() + datagram.headerSize, datagram.data, datagram.dataSize);
+        broadcast(buffer.data(), static_cast<unsigned int>(buffer.size()));
+    }
+
+#endif
+}
@@ -20,6 +20,7 @@
 */
 
 #include <string>
+#include <vector>
 #include <vsg/core/Inherit.h>
 
 ////////////////////////////////////////////////////////////
@@ -37,6 +38,18 @@
 
 std::vector<std::string> listNetworkConnections();
 
+// return the MTU of the named network interface, or 0 if it can't be determined
+uint32_t getNetworkMTU(const std::string& ifrName);
+
+// scatter/gather description of a single datagram, the header and data are sent together without first copying them into a contiguous buffer
+struct Datagram
+{
+    const void* header = nullptr;
+    unsigned int headerSize = 0;
+    const void* data = nullptr;
+    unsigned int dataSize = 0;
+};
+
 class Broadcaster : public vsg::Inherit<vsg::Object, Broadcaster>
 {
 public:
@@ -49,6 +62,18 @@ public:
 
     void broadcast(const void* buffer, unsigned int buffer_size);
 
+    // multicast settings, used when the host is a multicast group address, must be set before the first broadcast.
+    void setMulticastTTL(unsigned char ttl) { _multicastTTL = ttl; }
+    void setMulticastLoopback(bool loopback) { _multicastLoopback = loopback; }
+
+    bool isMulticast() const;
+
+    // MTU of the network interface that datagrams will be sent on, or 0 if unknown
+    uint32_t mtu() const;
+
+    // broadcast a batch of datagrams, using sendmmsg() where available to minimize the number of system calls
+    void broadcast(const std::vector<Datagram>& datagrams);
+
 private:
     bool init(void);
 
@@ -70,4 +95,7 @@ private:
     struct sockaddr_in saddr;
 #endif
     unsigned long _address;
+
+    unsigned char _multicastTTL = 1;
+    bool _multicastLoopback = true;
 };
@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "Codec.h"
+
+#ifdef LZ4_FOUND
+#    include <lz4.h>
+#endif
+
+#ifdef ZSTD_FOUND
+#    include <zstd.h>
+#endif
+
+namespace
+{
+    const std::size_t PREFIX_SIZE = sizeof(uint64_t);
+
+#ifndef LZ4_FOUND
+    //////////////////////////////////////////////////////////////////////////////////////
+    //
+    // bundled LZ4 block format encoder/decoder, used when liblz4 isn't available
+    //
+    const std::size_t MIN_MATCH = 4;
+    const std::size_t LAST_LITERALS = 5;
+    const std::size_t MF_LIMIT = 12;
+    const std::size_t MAX_OFFSET = 65535;
+    const int HASH_BITS = 16;
+
+    inline uint32_t read32(const uint8_t* ptr)
+    {
+        uint32_t value;
+        std::memcpy(&value, ptr, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t hash32(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    inline void writeLength(std::string& dest, std::size_t length)
+    {
+        while (length >= 255)
+        {
+            dest.push_back(static_cast<char>(255));
+            length -= 255;
+        }
+        dest.push_back(static_cast<char>(length));
+    }
+
+    void writeSequence(std::string& dest, const uint8_t* literals, std::size_t literalLength, std::size_t offset, std::size_t matchLength)
+    {
+        std::size_t matchCode = matchLength - MIN_MATCH;
+        uint8_t token = static_cast<uint8_t>((std::min<std::size_t>(literalLength, 15) << 4) | std::min<std::size_t>(matchCode, 15));
+        dest.push_back(static_cast<char>(token));
+
+        if (literalLength >= 15) writeLength(dest, literalLength - 15);
+        dest.append(reinterpret_cast<const char*>(literals), literalLength);
+
+        dest.push_back(static_cast<char>(offset & 0xff));
+        dest.push_back(static_cast<char>((offset >> 8) & 0xff));
+
+        if (matchCode >= 15) writeLength(dest, matchCode - 15);
+    }
+
+    void writeLastLiterals(std::string& dest, const uint8_t* literals, std::size_t literalLength)
+    {
+        uint8_t token = static_cast<uint8_t>(std::min<std::size_t>(literalLength, 15) << 4);
+        dest.push_back(static_cast<char>(token));
+
+        if (literalLength >= 15) writeLength(dest, literalLength - 15);
+        dest.append(reinterpret_cast<const char*>(literals), literalLength);
+    }
+
+    void lz4Compress(const uint8_t* src, std::size_t size, std::string& dest)
+    {
+        std::size_t anchor = 0;
+
+        if (size > MF_LIMIT)
+        {
+            std::vector<int64_t> table(std::size_t(1) << HASH_BITS, -1);
+
+            std::size_t matchLimit = size - LAST_LITERALS;
+            std::size_t ip = 0;
+            while (ip < size - MF_LIMIT)
+            {
+                uint32_t sequence = read32(src + ip);
+                uint32_t h = hash32(sequence);
+                int64_t ref = table[h];
+                table[h] = static_cast<int64_t>(ip);
+
+                if (ref < 0 || (ip - static_cast<std::size_t>(ref)) > MAX_OFFSET || read32(src + ref) != sequence)
+                {
+                    ++ip;
+                    continue;
+                }
+
+                std::size_t matchLength = MIN_MATCH;
+                while (ip + matchLength < matchLimit && src[ref + matchLength] == src[ip + matchLength]) ++matchLength;
+
+                writeSequence(dest, src + anchor, ip - anchor, ip - static_cast<std::size_t>(ref), matchLength);
+
+                ip += matchLength;
+                anchor = ip;
+            }
+        }
+
+        writeLastLiterals(dest, src + anchor, size - anchor);
+    }
+
+    bool readLength(const uint8_t*& ip, const uint8_t* end, std::size_t& length)
+    {
+        uint8_t value = 255;
+        while (value == 255)
+        {
+            if (ip >= end) return false;
+            value = *ip++;
+            length += value;
+        }
+        return true;
+    }
+
+    bool lz4Decompress(const uint8_t* src, std::size_t size, uint8_t* dest, std::size_t destSize)
+    {
+        const uint8_t* ip = src;
+        const uint8_t* end = src + size;
+        uint8_t* op = dest;
+        uint8_t* op_end = dest + destSize;
+
+        while (ip < end)
+        {
+            uint8_t token = *ip++;
+
+            std::size_t literalLength = token >> 4;
+            if (literalLength == 15 && !readLength(ip, end, literalLength)) return false;
+
+            if (literalLength > static_cast<std::size_t>(end - ip) || literalLength > static_cast<std::size_t>(op_end - op)) return false;
+            std::memcpy(op, ip, literalLength);
+            ip += literalLength;
+            op += literalLength;
+
+            // the last sequence has no match
+            if (ip == end) break;
+
+            if (end - ip < 2) return false;
+            std::size_t offset = static_cast<std::size_t>(ip[0]) | (static_cast<std::size_t>(ip[1]) << 8);
+            ip += 2;
+
+            std::size_t matchLength = token & 15;
+            if (matchLength == 15 && !readLength(ip, end, matchLength)) return false;
+            matchLength += MIN_MATCH;
+
+            if (offset == 0 || offset > static_cast<std::size_t>(op - dest) || matchLength > static_cast<std::size_t>(op_end - op)) return false;
+
+            // matches may overlap the output so copy byte by byte
+            const uint8_t* match = op - offset;
+            for (std::size_t i = 0; i < matchLength; ++i) op[i] = match[i];
+            op += matchLength;
+        }
+
+        return op == op_end;
+    }
+#endif
+
+    void writePrefix(std::string& dest, uint64_t size)
+    {
+        dest.resize(PREFIX_SIZE);
+        std::memcpy(&dest[0], &size, PREFIX_SIZE);
+    }
+
+} // namespace
+
+Codec codecFromName(const std::string& name)
+{
+    if (name == "lz4") return CODEC_LZ4;
+    if (name == "zstd") return CODEC_ZSTD;
+    return CODEC_NONE;
+}
+
+const char* codecName(Codec codec)
+{
+    switch (codec)
+    {
+    case CODEC_LZ4: return "lz4";
+    case CODEC_ZSTD: return "zstd";
+    default: return "none";
+    }
+}
+
+bool codecSupported(Codec codec)
+{
+    switch (codec)
+    {
+    case CODEC_NONE: return true;
+    case CODEC_LZ4: return true;
+#ifdef ZSTD_FOUND
+    case CODEC_ZSTD: return true;
+#endif
+    default: return false;
+    }
+}
+
+Codec compress(Codec codec, const std::string& src, std::string& dest, int level)
+{
+    dest.clear();
+
+#ifndef ZSTD_FOUND
+    if (codec == CODEC_ZSTD)
+    {
+        static bool warned = false;
+        if (!warned) std::cerr << "compress() zstd not available, using lz4 instead." << std::endl;
+        warned = true;
+        codec = CODEC_LZ4;
+    }
+#endif
+
+    if (codec == CODEC_NONE || src.empty()) return CODEC_NONE;
+
+    writePrefix(dest, src.size());
+
+    if (codec == CODEC_LZ4)
+    {
+#ifdef LZ4_FOUND
+        int bound = LZ4_compressBound(static_cast<int>(src.size()));
+        dest.resize(PREFIX_SIZE + bound);
+        int result = LZ4_compress_default(src.data(), &dest[PREFIX_SIZE], static_cast<int>(src.size()), bound);
+        if (result <= 0)
+        {
+            dest.clear();
+            return CODEC_NONE;
+        }
+        dest.resize(PREFIX_SIZE + result);
+#else
+        dest.reserve(PREFIX_SIZE + src.size() + src.size() / 255 + 16);
+        lz4Compress(reinterpret_cast<const uint8_t*>(src.data()), src.size(), dest);
+#endif
+    }
+#ifdef ZSTD_FOUND
+    else if (codec == CODEC_ZSTD)
+    {
+        std::size_t bound = ZSTD_compressBound(src.size());
+        dest.resize(PREFIX_SIZE + bound);
+        std::size_t result = ZSTD_compress(&dest[PREFIX_SIZE], bound, src.data(), src.size(), level > 0 ? level : 1);
+        if (ZSTD_isError(result))
+        {
+            dest.clear();
+            return CODEC_NONE;
+        }
+        dest.resize(PREFIX_SIZE + result);
+    }
+#endif
+    else
+    {
+        dest.clear();
+        return CODEC_NONE;
+    }
+
+    // not worth sending compressed
+    if (dest.size() >= src.size())
+    {
+        dest.clear();
+        return CODEC_NONE;
+    }
+
+    (void)level;
+    return codec;
+}
+
+bool decompress(Codec codec, const std::string& src, std::string& dest, uint64_t maxSize)
+{
+    if (src.size() < PREFIX_SIZE) return false;
+
+    uint64_t size = 0;
+    std::memcpy(&size, src.data(), PREFIX_SIZE);
+
+    const char* compressed = src.data() + PREFIX_SIZE;
+    std::size_t compressedSize = src.size() - PREFIX_SIZE;
+
+    // the size prefix comes from the sender so check it before allocating
+    if (size > maxSize)
+    {
+        std::cerr << "decompress() uncompressed size " << size << " exceeds the maximum of " << maxSize << "." << std::endl;
+        return false;
+    }
+
+    if (codec == CODEC_LZ4)
+    {
+        // each byte of an LZ4 block can expand to at most 255 bytes, so larger sizes can only come from a corrupt prefix
+        if (size > static_cast<uint64_t>(compressedSize) * 255 + 16) return false;
+
+        dest.resize(size);
+
+#ifdef LZ4_FOUND
+        int result = LZ4_decompress_safe(compressed, &dest[0], static_cast<int>(compressedSize), static_cast<int>(size));
+        return result >= 0 && static_cast<uint64_t>(result) == size;
+#else
+        return lz4Decompress(reinterpret_cast<const uint8_t*>(compressed), compressedSize, reinterpret_cast<uint8_t*>(&dest[0]), size);
+#endif
+    }
+#ifdef ZSTD_FOUND
+    else if (codec == CODEC_ZSTD)
+    {
+        // ZSTD_compress() records the content size in the frame, which has to agree with the prefix
+        if (ZSTD_getFrameContentSize(compressed, compressedSize) != size) return false;
+
+        dest.resize(size);
+
+        std::size_t result = ZSTD_decompress(&dest[0], size, compressed, compressedSize);
+        return !ZSTD_isError(result) && result == size;
+    }
+#endif
+
+    std::cerr << "decompress() codec " << codecName(codec) << " not supported." << std::endl;
+    return false;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+////////////////////////////////////////////////////////////
+// Codec.h
+//
+// Compression of packet payloads between vsg::VSG::write()/read() and the PacketSet.
+// LZ4 and zstd are used when the libraries are found at build time, otherwise LZ4 falls back
+// to a bundled implementation of the LZ4 block format so all nodes can always decode LZ4.
+//
+// Compressed payloads are prefixed with the uint64_t uncompressed size.
+//
+// Which codecs can be decoded depends on the build, so a node that can't decode the codec its
+// cluster has been configured with should refuse to start rather than fail on every payload.
+//
+
+enum Codec : uint32_t
+{
+    CODEC_NONE = 0,
+    CODEC_LZ4 = 1,
+    CODEC_ZSTD = 2
+};
+
+// map "none", "lz4" or "zstd" to a Codec, returns CODEC_NONE for unrecognised names
+Codec codecFromName(const std::string& name);
+
+const char* codecName(Codec codec);
+
+// true if payloads compressed with codec can be decompressed by this build
+bool codecSupported(Codec codec);
+
+// default upper bound on the uncompressed size accepted by decompress(), guarding against corrupt size prefixes
+const uint64_t MAX_UNCOMPRESSED_SIZE = uint64_t(1) << 30;
+
+// compress src into dest, returns the codec actually used, which will be CODEC_LZ4 if zstd isn't available,
+// or CODEC_NONE if compression wasn't possible or didn't reduce the size, in which case dest is left empty.
+Codec compress(Codec codec, const std::string& src, std::string& dest, int level = 0);
+
+// decompress src into dest, returns false if the codec isn't supported, the data is corrupt or its uncompressed size exceeds maxSize
+bool decompress(Codec codec, const std::string& src, std::string& dest, uint64_t maxSize = MAX_UNCOMPRESSED_SIZE);
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Streaming implementation of the xxHash64 algorithm, used to compute a fast content hash of a PacketSet's payload.
+// The main loop consumes four independent 64bit lanes per 32 byte stripe so it pipelines well on modern CPUs.
+class Hash64
+{
+public:
+    explicit Hash64(uint64_t seed = 0) { reset(seed); }
+
+    void reset(uint64_t seed = 0)
+    {
+        _v[0] = seed + PRIME64_1 + PRIME64_2;
+        _v[1] = seed + PRIME64_2;
+        _v[2] = seed;
+        _v[3] = seed - PRIME64_1;
+        _seed = seed;
+        _totalSize = 0;
+        _bufferSize = 0;
+    }
+
+    void update(const void* data, std::size_t size)
+    {
+        auto ptr = static_cast<const uint8_t*>(data);
+        auto end = ptr + size;
+
+        _totalSize += size;
+
+        // complete any partially filled stripe from a previous update
+        if (_bufferSize > 0)
+        {
+            std::size_t fill = STRIPE_SIZE - _bufferSize;
+            if (size < fill)
+            {
+                std::memcpy(_buffer + _bufferSize, ptr, size);
+                _bufferSize += size;
+                return;
+            }
+
+            std::memcpy(_buffer + _bufferSize, ptr, fill);
+            consumeStripe(_buffer);
+            ptr += fill;
+            _bufferSize = 0;
+        }
+
+        while (ptr + STRIPE_SIZE <= end)
+        {
+            consumeStripe(ptr);
+            ptr += STRIPE_SIZE;
+        }
+
+        if (ptr < end)
+        {
+            _bufferSize = static_cast<std::size_t>(end - ptr);
+            std::memcpy(_buffer, ptr, _bufferSize);
+        }
+    }
+
+    uint64_t digest() const
+    {
+        uint64_t h;
+        if (_totalSize >= STRIPE_SIZE)
+        {
+            h = rotl(_v[0], 1) + rotl(_v[1], 7) + rotl(_v[2], 12) + rotl(_v[3], 18);
+            for (auto v : _v) h = mergeRound(h, v);
+        }
+        else
+        {
+            h = _seed + PRIME64_5;
+        }
+
+        h += _totalSize;
+
+        const uint8_t* ptr = _buffer;
+        const uint8_t* end = _buffer + _bufferSize;
+        while (ptr + 8 <= end)
+        {
+            h ^= round(0, read64(ptr));
+            h = rotl(h, 27) * PRIME64_1 + PRIME64_4;
+            ptr += 8;
+        }
+
+        if (ptr + 4 <= end)
+        {
+            h ^= static_cast<uint64_t>(read32(ptr)) * PRIME64_1;
+            h = rotl(h, 23) * PRIME64_2 + PRIME64_3;
+            ptr += 4;
+        }
+
+        while (ptr < end)
+        {
+            h ^= static_cast<uint64_t>(*ptr) * PRIME64_5;
+            h = rotl(h, 11) * PRIME64_1;
+            ++ptr;
+        }
+
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static uint64_t compute(const void* data, std::size_t size, uint64_t seed = 0)
+    {
+        Hash64 hash(seed);
+        hash.update(data, size);
+        return hash.digest();
+    }
+
+protected:
+    static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+    static constexpr std::size_t STRIPE_SIZE = 32;
+
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    static uint64_t read64(const uint8_t* ptr)
+    {
+        uint64_t value;
+        std::memcpy(&value, ptr, sizeof(value));
+        return value;
+    }
+
+    static uint32_t read32(const uint8_t* ptr)
+    {
+        uint32_t value;
+        std::memcpy(&value, ptr, sizeof(value));
+        return value;
+    }
+
+    static uint64_t round(uint64_t acc, uint64_t input)
+    {
+        acc += input * PRIME64_2;
+        acc = rotl(acc, 31);
+        return acc * PRIME64_1;
+    }
+
+    static uint64_t mergeRound(uint64_t acc, uint64_t value)
+    {
+        acc ^= round(0, value);
+        return acc * PRIME64_1 + PRIME64_4;
+    }
+
+    void consumeStripe(const uint8_t* ptr)
+    {
+        _v[0] = round(_v[0], read64(ptr));
+        _v[1] = round(_v[1], read64(ptr + 8));
+        _v[2] = round(_v[2], read64(ptr + 16));
+        _v[3] = round(_v[3], read64(ptr + 24));
+    }
+
+    uint64_t _v[4];
+    uint64_t _seed;
+    uint64_t _totalSize;
+    uint8_t _buffer[STRIPE_SIZE];
+    std::size_t _bufferSize;
+};
@@ -1,6 +1,11 @@
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <set>
 #include <sstream>
+#include <thread>
 
 #include "Packet.h"
 
@@ -10,7 +15,8 @@
 //
 // Packet
 //
-Packet::Packet()
+Packet::Packet(uint64_t dataCapacity) :
+    data(dataCapacity)
 {
 //    std::cout<<"Packet() "<< this<<std::endl;
 }
@@ -20,6 +26,21 @@ Packet::~Packet()
 //    std::cout<<"~Packet() "<< this<<std::endl;
 }
 
+bool Packet::valid() const
+{
+    return header.packetCount > 0 &&
+           header.packetIndex < header.packetCount + numParityPackets() &&
+           header.packetSize <= header.packetDataSize &&
+           header.packetDataSize <= data.size();
+}
+
+uint64_t computePacketDataSize(uint32_t mtu)
+{
+    // an MTU too small to carry the packet header and any data can't be used, so is treated as unknown
+    uint64_t datagramSize = (mtu > IP_UDP_HEADER_SIZE + sizeof(Packet::Header)) ? std::min(static_cast<uint64_t>(mtu) - IP_UDP_HEADER_SIZE, MAX_DATAGRAM_SIZE) : DEFAULT_DATAGRAM_SIZE;
+    return datagramSize - sizeof(Packet::Header);
+}
+
 //////////////////////////////////////////////////////////////////////////////////////
 //
 // Packets
@@ -31,15 +52,61 @@ void PacketSet::clear()
         pool.emplace(std::move(packet.second));
     }
     packets.clear();
+
+    packetCount = 0;
+    parityGroupSize = 0;
+    numDataPackets = 0;
+    numParityPackets = 0;
 }
 
 bool PacketSet::add(std::unique_ptr<Packet> packet)
 {
-    bool complete = (packets.size() + 1) == packet->header.packetCount;
+    auto& header = packet->header;
 
-    packets[packet->header.packetIndex] = std::move(packet);
+    if (!packet->valid())
+    {
+        pool.emplace(std::move(packet));
+        return false;
+    }
+
+    if (!packets.empty())
+    {
+        // every packet of a set shares the same description of the payload, a mismatch is a malformed packet or another sender reusing the set number
+        auto& first = packets.begin()->second->header;
+        if (header.totalSize != first.totalSize || header.packetCount != first.packetCount || header.packetDataSize != first.packetDataSize ||
+            header.hash != first.hash || header.parityGroupSize != first.parityGroupSize || header.codec != first.codec)
+        {
+            pool.emplace(std::move(packet));
+            return false;
+        }
+    }
+
+    packetCount = header.packetCount;
+    parityGroupSize = header.parityGroupSize;
+
+    if (packets.empty()) firstPacketTime = std::chrono::steady_clock::now();
+
+    if (packets.count(header.packetIndex) != 0)
+    {
+        // duplicate packet
+        pool.emplace(std::move(packet));
+        return false;
+    }
+
+    if (header.packetIndex < packetCount) ++numDataPackets;
+    else ++numParityPackets;
+
+    packets[header.packetIndex] = std::move(packet);
+
+    if (numDataPackets == packetCount) return true;
+
+    // with one parity packet per group at least packetCount packets are required before reconstruction is possible
+    if (parityGroupSize > 0 && (numDataPackets + numParityPackets) >= packetCount)
+    {
+        return reconstruct();
+    }
 
-    return complete;
+    return false;
 }
 
 void PacketSet::copy(const std::string& str)
@@ -58,21 +125,23 @@ void PacketSet::copy(const std::string& str)
         std::size_t remaining = totalSize - i;
 
         packet->header.packetIndex = packetIndex;
-        packet->header.packetSize = (remaining < DATA_SIZE) ? remaining : DATA_SIZE;
+        packet->header.packetSize = static_cast<uint32_t>(std::min<uint64_t>(remaining, dataSize));
+        packet->header.packetDataSize = static_cast<uint32_t>(dataSize);
 
-        for(std::size_t j = 0; j < packet->header.packetSize; ++j, ++i)
-        {
-            packet->data[j] = str[i];
-        }
+        std::memcpy(packet->data.data(), str.data() + i, packet->header.packetSize);
+        i += packet->header.packetSize;
 
         packets[packetIndex] = std::move(packet);
         ++packetIndex;
     }
 
+    uint64_t hash = Hash64::compute(str.data(), str.size());
+
     for(auto& packet : packets)
     {
         packet.second->header.packetCount = packetIndex;
         packet.second->header.totalSize = totalSize;
+        packet.second->header.hash = hash;
     }
 }
 
@@ -84,162 +153,943 @@ std::string PacketSet::assemble() const
     }
 
     std::size_t i = 0;
-    std::size_t totalSize = packets.begin()->second->header.totalSize;
+    auto& firstHeader = packets.begin()->second->header;
+    std::size_t totalSize = firstHeader.totalSize;
+    uint32_t count = firstHeader.packetCount;
+    uint64_t expectedHash = firstHeader.hash;
+
+    // don't allocate more than the packets could possibly hold
+    if (totalSize > static_cast<uint64_t>(count) * firstHeader.packetDataSize)
+    {
+        std::cerr<<"PacketSet::assemble() invalid totalSize for set "<<firstHeader.set<<", discarding."<<std::endl;
+        return {};
+    }
 
     std::string str(totalSize, '\0');
 
+    Hash64 hash;
     for(auto& packet : packets)
     {
-        for(std::size_t j=0; j<packet.second->header.packetSize; ++j, ++i)
+        // parity packets follow the data packets
+        if (packet.first >= count) break;
+
+        // the header fields come from the sender so check the copy stays within both buffers
+        uint32_t packetSize = packet.second->header.packetSize;
+        if (packetSize > packet.second->data.size() || packetSize > totalSize - i)
         {
-            str[i] = packet.second->data[j];
+            std::cerr<<"PacketSet::assemble() packet size overflows set "<<firstHeader.set<<", discarding."<<std::endl;
+            return {};
         }
+
+        std::memcpy(&str[i], packet.second->data.data(), packetSize);
+        hash.update(packet.second->data.data(), packetSize);
+        i += packetSize;
+    }
+
+    if (i != totalSize || hash.digest() != expectedHash)
+    {
+        std::cerr<<"PacketSet::assemble() hash mismatch for set "<<packets.begin()->second->header.set<<", discarding."<<std::endl;
+        return {};
     }
 
     return str;
 }
 
+bool PacketSet::verify() const
+{
+    if (packets.empty()) return false;
+
+    std::size_t totalSize = packets.begin()->second->header.totalSize;
+    uint32_t count = packets.begin()->second->header.packetCount;
+    uint64_t expectedHash = packets.begin()->second->header.hash;
+
+    std::size_t i = 0;
+    Hash64 hash;
+    for(auto& packet : packets)
+    {
+        if (packet.first >= count) break;
+
+        // the header fields come from the sender so check the packets stay within their buffers and the totalSize
+        uint32_t packetSize = packet.second->header.packetSize;
+        if (packetSize > packet.second->data.size() || packetSize > totalSize - i)
+        {
+            std::cerr<<"PacketSet::verify() packet size overflows set "<<packets.begin()->second->header.set<<", discarding."<<std::endl;
+            return false;
+        }
+
+        hash.update(packet.second->data.data(), packetSize);
+        i += packetSize;
+    }
+
+    if (i != totalSize || hash.digest() != expectedHash)
+    {
+        std::cerr<<"PacketSet::verify() hash mismatch for set "<<packets.begin()->second->header.set<<", discarding."<<std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void PacketSet::addParity(uint32_t groupSize)
+{
+    if (packets.empty() || groupSize == 0) return;
+
+    auto& firstHeader = packets.begin()->second->header;
+    uint32_t count = firstHeader.packetCount;
+    uint32_t numGroups = (count + groupSize - 1) / groupSize;
+
+    for(auto& packet : packets)
+    {
+        packet.second->header.parityGroupSize = groupSize;
+    }
+
+    for(uint32_t group = 0; group < numGroups; ++group)
+    {
+        auto parity = createPacket();
+        parity->header = firstHeader;
+        parity->header.packetIndex = count + group;
+        parity->header.packetSize = 0;
+
+        std::memset(parity->data.data(), 0, parity->header.packetDataSize);
+
+        uint32_t end = std::min(count, (group + 1) * groupSize);
+        for(uint32_t index = group * groupSize; index < end; ++index)
+        {
+            auto& packet = packets[index];
+            for(std::size_t j = 0; j < packet->header.packetSize; ++j)
+            {
+                parity->data[j] ^= packet->data[j];
+            }
+            parity->header.packetSize = std::max(parity->header.packetSize, packet->header.packetSize);
+        }
+
+        packets[parity->header.packetIndex] = std::move(parity);
+    }
+}
+
+bool PacketSet::reconstruct()
+{
+    if (numDataPackets == packetCount) return true;
+    if (parityGroupSize == 0) return false;
+
+    uint32_t numGroups = (packetCount + parityGroupSize - 1) / parityGroupSize;
+
+    // all data packets except the last are full, so the totalSize has to fall within the last packet for the missing packet sizes to be computed
+    auto& firstHeader = packets.begin()->second->header;
+    uint64_t packetDataSize = firstHeader.packetDataSize;
+    uint64_t fullPacketsSize = static_cast<uint64_t>(packetCount - 1) * packetDataSize;
+    if (firstHeader.totalSize < fullPacketsSize || firstHeader.totalSize - fullPacketsSize > packetDataSize) return false;
+
+    // first check every group is recoverable, i.e. has at most one missing data packet and if so has its parity packet.
+    std::vector<uint32_t> missing;
+    for(uint32_t group = 0; group < numGroups; ++group)
+    {
+        uint32_t end = std::min(packetCount, (group + 1) * parityGroupSize);
+        uint32_t numMissing = 0;
+        uint32_t missingIndex = 0;
+        for(uint32_t index = group * parityGroupSize; index < end; ++index)
+        {
+            if (packets.count(index) == 0)
+            {
+                ++numMissing;
+                missingIndex = index;
+            }
+        }
+
+        if (numMissing == 0) continue;
+        if (numMissing > 1 || packets.count(packetCount + group) == 0) return false;
+
+        missing.push_back(missingIndex);
+    }
+
+    // recreate each missing packet by XORing the parity packet with the other data packets of its group.
+    for(auto index : missing)
+    {
+        uint32_t group = index / parityGroupSize;
+        auto& parity = packets[packetCount + group];
+
+        auto packet = createPacket();
+        packet->header = parity->header;
+        packet->header.packetIndex = index;
+
+        packet->header.packetSize = static_cast<uint32_t>((index + 1 < packetCount) ? packetDataSize : (firstHeader.totalSize - fullPacketsSize));
+
+        packet->reserve(packet->header.packetSize);
+        std::memcpy(packet->data.data(), parity->data.data(), packet->header.packetSize);
+
+        uint32_t end = std::min(packetCount, (group + 1) * parityGroupSize);
+        for(uint32_t other = group * parityGroupSize; other < end; ++other)
+        {
+            if (other == index) continue;
+
+            auto& source = packets[other];
+            std::size_t size = std::min(source->header.packetSize, packet->header.packetSize);
+            for(std::size_t j = 0; j < size; ++j)
+            {
+                packet->data[j] ^= source->data[j];
+            }
+        }
+
+        packets[index] = std::move(packet);
+        ++numDataPackets;
+    }
+
+    return true;
+}
+
+void PacketSet::missingPackets(uint32_t endIndex, std::vector<uint32_t>& missing) const
+{
+    endIndex = std::min(endIndex, packetCount);
+
+    // walk the ordered packets looking for gaps rather than looking up every index
+    uint32_t expected = 0;
+    for(auto& packet : packets)
+    {
+        if (packet.first >= endIndex) break;
+
+        for(; expected < packet.first; ++expected) missing.push_back(expected);
+        expected = packet.first + 1;
+    }
+
+    for(; expected < endIndex; ++expected) missing.push_back(expected);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// PacketStreamBuffer
+//
+PacketStreamBuffer::PacketStreamBuffer(PacketSet& in_packetSet) :
+    packetSet(in_packetSet)
+{
+    packetSet.clear();
+}
+
+void PacketStreamBuffer::completeCurrentPacket()
+{
+    if (currentPacket)
+    {
+        currentPacket->header.packetSize = static_cast<uint32_t>(pptr() - pbase());
+        hash.update(pbase(), currentPacket->header.packetSize);
+    }
+}
+
+void PacketStreamBuffer::nextPacket()
+{
+    completeCurrentPacket();
+
+    auto packet = packetSet.createPacket();
+    packet->header.packetIndex = packetIndex;
+    packet->header.packetSize = 0;
+    packet->header.packetDataSize = static_cast<uint32_t>(packetSet.dataSize);
+
+    currentPacket = packet.get();
+    packetSet.packets[packetIndex++] = std::move(packet);
+
+    char* begin = reinterpret_cast<char*>(currentPacket->data.data());
+    setp(begin, begin + packetSet.dataSize);
+}
+
+PacketStreamBuffer::int_type PacketStreamBuffer::overflow(int_type ch)
+{
+    nextPacket();
+
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize PacketStreamBuffer::xsputn(const char_type* s, std::streamsize count)
+{
+    std::streamsize written = 0;
+    while (written < count)
+    {
+        std::streamsize available = epptr() - pptr();
+        if (available == 0)
+        {
+            nextPacket();
+            continue;
+        }
+
+        std::streamsize size = std::min(available, count - written);
+        std::memcpy(pptr(), s + written, static_cast<std::size_t>(size));
+        pbump(static_cast<int>(size));
+        written += size;
+    }
+    return written;
+}
+
+void PacketStreamBuffer::finish()
+{
+    completeCurrentPacket();
+
+    uint64_t totalSize = 0;
+    for(auto& packet : packetSet.packets)
+    {
+        totalSize += packet.second->header.packetSize;
+    }
+
+    uint64_t digest = hash.digest();
+
+    for(auto& packet : packetSet.packets)
+    {
+        packet.second->header.packetCount = packetIndex;
+        packet.second->header.totalSize = totalSize;
+        packet.second->header.hash = digest;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// PacketSetInputBuffer
+//
+PacketSetInputBuffer::PacketSetInputBuffer(const PacketSet& in_packetSet) :
+    packetSet(in_packetSet),
+    nextPacket(in_packetSet.packets.begin())
+{
+    if (!packetSet.packets.empty()) packetCount = packetSet.packets.begin()->second->header.packetCount;
+}
+
+PacketSetInputBuffer::int_type PacketSetInputBuffer::underflow()
+{
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    // move on to the next data packet, skipping any that are empty, parity packets follow the data packets so end the stream.
+    while(nextPacket != packetSet.packets.end() && nextPacket->first < packetCount)
+    {
+        packetStart += egptr() - eback();
+
+        auto& packet = *(nextPacket->second);
+        ++nextPacket;
+
+        if (packet.header.packetSize == 0) continue;
+
+        char* begin = reinterpret_cast<char*>(const_cast<uint8_t*>(packet.data.data()));
+        setg(begin, begin, begin + packet.header.packetSize);
+
+        return traits_type::to_int_type(*gptr());
+    }
+
+    return traits_type::eof();
+}
+
+PacketSetInputBuffer::pos_type PacketSetInputBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    // only reporting the current position, as used by tellg(), is supported
+    if (off != 0 || dir != std::ios_base::cur || (which & std::ios_base::in) == 0) return pos_type(off_type(-1));
+
+    return pos_type(packetStart + (gptr() - eback()));
+}
+
 //////////////////////////////////////////////////////////////////////////////////////
 //
 // PacketBroadcaster
 //
-void PacketBroadcaster::broadcast(uint64_t set, vsg::ref_ptr<vsg::Object> object)
+void PacketBroadcaster::serialize(PacketSet& packetSet, uint64_t set, uint32_t flags, vsg::ref_ptr<vsg::Object> object)
 {
+    if (datagramSize == 0)
+    {
+        // select the largest datagram that fits within the MTU of the network interface
+        datagramSize = computePacketDataSize(broadcaster->mtu()) + sizeof(Packet::Header);
+    }
+    packetSet.dataSize = std::min(std::max(datagramSize, static_cast<uint64_t>(sizeof(Packet::Header) + 1)), MAX_DATAGRAM_SIZE) - sizeof(Packet::Header);
+
     auto options = vsg::Options::create();
     options->extensionHint = "vsgb";
 
-    std::ostringstream ostr(std::ios::out | std::ios::binary);
     vsg::VSG rw;
-    rw.write(object, ostr, options);
+    Codec usedCodec = CODEC_NONE;
+
+    if (codec != CODEC_NONE)
+    {
+        std::ostringstream ostr(std::ios::out | std::ios::binary);
+        rw.write(object, ostr, options);
+
+        auto str = ostr.str();
+        usedCodec = compress(codec, str, compressed, compressionLevel);
+        packetSet.copy(usedCodec != CODEC_NONE ? compressed : str);
+    }
+    else
+    {
+        // serialize straight into the pooled packets
+        PacketStreamBuffer buffer(packetSet);
+        std::ostream ostr(&buffer);
+        rw.write(object, ostr, options);
+        buffer.finish();
+    }
 
-    packets.copy(ostr.str());
+    for(auto& packet : packetSet.packets)
+    {
+        packet.second->header.codec = usedCodec;
+    }
+
+    if (parityGroupSize > 0) packetSet.addParity(parityGroupSize);
+
+    for(auto& packet : packetSet.packets)
+    {
+        auto& header = packet.second->header;
+        header.set = set;
+        header.flags = flags;
+        header.reliableSetCount = reliableSetCount;
+    }
+}
 
-    for(auto& packet : packets.packets)
+void PacketBroadcaster::send(const PacketSet& packetSet)
+{
+    datagrams.clear();
+    for(auto& packet : packetSet.packets)
     {
         Packet& ref = *packet.second;
-        ref.header.set = set;
-        std::size_t size = sizeof(Packet::Header) + ref.header.packetSize;
-        broadcaster->broadcast(&ref, static_cast<unsigned int>(size));
+        datagrams.push_back(Datagram{&ref.header, sizeof(Packet::Header), ref.data.data(), ref.header.packetSize});
+    }
+
+    broadcaster->broadcast(datagrams);
+
+    TransportStats::add(stats->packetSetsSent, 1);
+    TransportStats::add(stats->packetsSent, datagrams.size());
+    for(auto& datagram : datagrams) TransportStats::add(stats->bytesSent, datagram.headerSize + datagram.dataSize);
+}
+
+void PacketBroadcaster::broadcast(uint64_t set, vsg::ref_ptr<vsg::Object> object)
+{
+    serialize(packets, set, 0, object);
+    send(packets);
+}
+
+void PacketBroadcaster::refillTokens()
+{
+    auto now = std::chrono::steady_clock::now();
+    double maxTokens = static_cast<double>(std::max(reliableBurstSize, MAX_DATAGRAM_SIZE));
+    sendTokens = std::min(maxTokens, sendTokens + std::chrono::duration<double>(now - lastTokenTime).count() * reliableSendRate);
+    lastTokenTime = now;
+}
+
+void PacketBroadcaster::waitForTokens()
+{
+    if (reliableSendRate <= 0.0) return;
+
+    refillTokens();
+    if (sendTokens > 0.0) return;
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(-sendTokens / reliableSendRate));
+    refillTokens();
+}
+
+void PacketBroadcaster::broadcastReliable(vsg::ref_ptr<vsg::Object> object)
+{
+    // reuse the oldest PacketSet in the retransmit window, along with its pooled packets, once the window is full
+    std::unique_ptr<PacketSet> packetSet;
+    if (!retransmitWindow.empty() && retransmitWindow.size() >= retransmitWindowSize)
+    {
+        pendingRetransmissions.erase(reliableSetCount - retransmitWindow.size());
+
+        packetSet = std::move(retransmitWindow.front());
+        retransmitWindow.pop_front();
+    }
+    else
+    {
+        packetSet.reset(new PacketSet);
+    }
+
+    uint64_t set = reliableSetCount++;
+
+    serialize(*packetSet, set, Packet::Header::RELIABLE, object);
+
+    // the PacketSet joins the retransmit window before it's sent so that packets lost while the rest are paced out can be sent again
+    auto& sending = *packetSet;
+    retransmitWindow.push_back(std::move(packetSet));
+    numReliablePacketsSent = 0;
+
+    TransportStats::add(stats->packetSetsSent, 1);
+
+    auto itr = sending.packets.begin();
+    while(itr != sending.packets.end())
+    {
+        // retransmissions take priority over the rest of the PacketSet
+        waitForTokens();
+        processNacks();
+        if (!pendingRetransmissions.empty()) continue;
+
+        datagrams.clear();
+        uint64_t numBytes = 0;
+        for(; itr != sending.packets.end() && (datagrams.empty() || numBytes < reliableBurstSize); ++itr)
+        {
+            Packet& ref = *itr->second;
+            datagrams.push_back(Datagram{&ref.header, sizeof(Packet::Header), ref.data.data(), ref.header.packetSize});
+            numBytes += sizeof(Packet::Header) + ref.header.packetSize;
+        }
+
+        broadcaster->broadcast(datagrams);
+        sendTokens -= static_cast<double>(numBytes);
+        numReliablePacketsSent += static_cast<uint32_t>(datagrams.size());
+
+        TransportStats::add(stats->packetsSent, datagrams.size());
+        TransportStats::add(stats->bytesSent, numBytes);
+    }
+}
+
+std::size_t PacketBroadcaster::processNacks()
+{
+    if (!nackReceiver) return 0;
+
+    // the retransmit window holds the most recent reliable PacketSet with consecutive set numbers, older requests can no longer be met so are ignored
+    uint64_t firstSet = reliableSetCount - retransmitWindow.size();
+
+    // gather the requests from all receivers first so packets lost by several receivers are only sent once
+    Nack nack;
+    unsigned int size = 0;
+    while((size = nackReceiver->recieve(&nack, sizeof(Nack))) > 0)
+    {
+        if (size < sizeof(Nack) - sizeof(Nack::packetIndices) || nack.magic != Nack::MAGIC || nack.numIndices > Nack::MAX_INDICES || size < nack.size()) continue;
+        if (nack.set < firstSet || nack.set >= reliableSetCount) continue;
+
+        // packets of the newest PacketSet that haven't been sent yet are still to come
+        uint32_t endIndex = (nack.set + 1 == reliableSetCount) ? numReliablePacketsSent : std::numeric_limits<uint32_t>::max();
+
+        auto& packetSet = *retransmitWindow[nack.set - firstSet];
+        for(uint32_t i = 0; i < nack.numIndices; ++i)
+        {
+            uint32_t index = nack.packetIndices[i];
+            if (index < endIndex && packetSet.packets.count(index) != 0) pendingRetransmissions[nack.set].insert(index);
+        }
+    }
+
+    if (pendingRetransmissions.empty()) return 0;
+
+    // send as many of the requested packets as the send rate allows, leaving the rest for later calls
+    bool paced = reliableSendRate > 0.0;
+    if (paced) refillTokens();
+
+    datagrams.clear();
+    auto set_itr = pendingRetransmissions.begin();
+    while(set_itr != pendingRetransmissions.end() && (!paced || sendTokens > 0.0))
+    {
+        auto& packetSet = *retransmitWindow[set_itr->first - firstSet];
+        auto& indices = set_itr->second;
+
+        auto index_itr = indices.begin();
+        for(; index_itr != indices.end() && (!paced || sendTokens > 0.0); ++index_itr)
+        {
+            Packet& ref = *packetSet.packets[*index_itr];
+            datagrams.push_back(Datagram{&ref.header, sizeof(Packet::Header), ref.data.data(), ref.header.packetSize});
+            sendTokens -= static_cast<double>(sizeof(Packet::Header) + ref.header.packetSize);
+        }
+
+        indices.erase(indices.begin(), index_itr);
+        if (indices.empty()) set_itr = pendingRetransmissions.erase(set_itr);
+        else ++set_itr;
     }
+
+    if (datagrams.empty()) return 0;
+
+    broadcaster->broadcast(datagrams);
+
+    TransportStats::add(stats->packetsRetransmitted, datagrams.size());
+    TransportStats::add(stats->packetsSent, datagrams.size());
+    for(auto& datagram : datagrams) TransportStats::add(stats->bytesSent, datagram.headerSize + datagram.dataSize);
+
+    return datagrams.size();
 }
 
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// PacketSetReader
+//
+vsg::ref_ptr<vsg::Object> PacketSetReader::read(const PacketSet& packetSet)
+{
+    if (packetSet.packets.empty()) return {};
+
+    uint64_t hash = packetSet.packets.begin()->second->header.hash;
+    if (lastObject && hash == lastHash)
+    {
+        // identical payload to the last one so skip deserialisation
+        return lastObject;
+    }
+
+    vsg::VSG rw;
+
+    auto codec = static_cast<Codec>(packetSet.packets.begin()->second->header.codec);
+    if (codec != CODEC_NONE)
+    {
+        auto str = packetSet.assemble();
+        if (str.empty()) return {};
+
+        std::string uncompressed;
+        if (!decompress(codec, str, uncompressed))
+        {
+            std::cerr<<"PacketSetReader::read() unable to decompress "<<codecName(codec)<<" payload."<<std::endl;
+            return {};
+        }
+
+        std::istringstream istr(uncompressed);
+        lastObject = rw.read(istr);
+    }
+    else
+    {
+        // read straight from the packets
+        if (!packetSet.verify()) return {};
+
+        PacketSetInputBuffer buffer(packetSet);
+        std::istream istr(&buffer);
+        lastObject = rw.read(istr);
+    }
+
+    lastHash = hash;
+
+    return lastObject;
+}
 
 //////////////////////////////////////////////////////////////////////////////////////
 //
 // PacketReciever
 //
+void PacketReceiver::reserve(std::size_t numPackets)
+{
+    for(std::size_t i = packetPool.size(); i < numPackets; ++i)
+    {
+        packetPool.emplace(new Packet(dataSize));
+    }
+}
+
 std::unique_ptr<Packet> PacketReceiver::createPacket()
 {
     if (!packetPool.empty())
     {
         std::unique_ptr<Packet> packet = std::move(packetPool.top());
         packetPool.pop();
+        TransportStats::add(stats->poolHits, 1);
         return packet;
     }
-#if 0
-    for(auto& packetSet : packetSetPool)
-    {
-        auto packet = packetSet->takePacketFromPool();
-        if (packet)
-        {
-            std::cout<<"PacketReceiver::createPacket() taken from inactive pool"<<std::endl;
-            return packet;
-        }
-    }
-#endif
+
     for(auto& packetSet : packetSetMap)
     {
         auto packet = packetSet.second->takePacketFromPool();
         if (packet)
         {
             // std::cout<<"PacketReceiver::createPacket() taken from active pool"<<std::endl;
+            TransportStats::add(stats->poolHits, 1);
             return packet;
         }
     }
 
     // std::cout<<"PacketReceiver::createPacket() created new Packet"<<std::endl;
-    return std::unique_ptr<Packet>(new Packet);
+    TransportStats::add(stats->poolMisses, 1);
+    return std::unique_ptr<Packet>(new Packet(dataSize));
+}
+
+void PacketReceiver::recycle(std::unique_ptr<PacketSet> packetSet)
+{
+    if (!packetSet) return;
+
+    packetSet->clear();
+
+    // move the packets back into the shared pool so they are available to whichever PacketSet needs them next
+    while(auto packet = packetSet->takePacketFromPool())
+    {
+        packetPool.emplace(std::move(packet));
+    }
+
+    packetSetPool.push(std::move(packetSet));
 }
 
-vsg::ref_ptr<vsg::Object> PacketReceiver::completed(uint64_t set)
+std::unique_ptr<PacketSet> PacketReceiver::completed(uint64_t set)
 {
     auto set_itr = packetSetMap.find(set);
     if (set_itr == packetSetMap.end()) return {};
 
-    // convert the PacketSet into a vsg::Object
-    std::istringstream istr((set_itr->second)->assemble());
-    vsg::VSG rw;
-    auto object = rw.read(istr);
+    auto packetSet = std::move(set_itr->second);
 
-    // clean up the PacketSet
-    auto next_itr = set_itr; ++next_itr;
+    recentlyCompletedSets.push_back(set);
+    if (recentlyCompletedSets.size() > 16) recentlyCompletedSets.pop_front();
 
-    for(auto itr = packetSetMap.begin(); itr != next_itr; ++itr)
+    // clean up the older, incomplete PacketSet
+    for(auto itr = packetSetMap.begin(); itr != set_itr; ++itr)
     {
-        itr->second->clear();
-        packetSetPool.push(std::move(itr->second));
+        recycle(std::move(itr->second));
+        TransportStats::add(stats->incompleteSetsDiscarded, 1);
     }
 
-    packetSetMap.erase(packetSetMap.begin(), next_itr);
+    TransportStats::add(stats->packetSetsCompleted, 1);
+    stats->recordAssemblyLatency(std::chrono::duration<double>(std::chrono::steady_clock::now() - packetSet->firstPacketTime).count());
 
-    return object;
+    packetSetMap.erase(packetSetMap.begin(), ++set_itr);
+
+    return packetSet;
+}
+
+std::unique_ptr<PacketSet> PacketReceiver::createPacketSet()
+{
+    if (!packetSetPool.empty())
+    {
+        //std::cout<<"Reusing a PacketSet from the pool."<<std::endl;
+        auto packetSet = std::move(packetSetPool.top());
+        packetSetPool.pop();
+        return packetSet;
+    }
+
+    //std::cout<<"Creating a new PacketSet."<<std::endl;
+    return std::unique_ptr<PacketSet>(new PacketSet);
 }
 
 bool PacketReceiver::add(std::unique_ptr<Packet> packet)
 {
+    reliableSetCount = std::max(reliableSetCount, packet->header.reliableSetCount);
+
+    if (packet->header.flags & Packet::Header::RELIABLE) return addReliable(std::move(packet));
+
     uint64_t set = packet->header.set;
 
-    if (packetSetMap.count(set) == 0)
+    if (std::find(recentlyCompletedSets.begin(), recentlyCompletedSets.end(), set) != recentlyCompletedSets.end())
+    {
+        // late packet for a set that has already been completed
+        packetPool.emplace(std::move(packet));
+        TransportStats::add(stats->latePackets, 1);
+        return false;
+    }
+
+    auto& packetSet = packetSetMap[set];
+    if (!packetSet)
     {
         // packet applies to a new set.
-        // need to get a PacketSet from the pool if one is available.
-        if (!packetSetPool.empty())
+        packetSet = createPacketSet();
+    }
+    return packetSet->add(std::move(packet));
+}
+
+bool PacketReceiver::addReliable(std::unique_ptr<Packet> packet)
+{
+    uint64_t set = packet->header.set;
+    uint32_t packetIndex = packet->header.packetIndex;
+
+    // check before a ReliableSet is created for it, or its header is used to decide what to request again
+    if (!packet->valid())
+    {
+        packetPool.emplace(std::move(packet));
+        TransportStats::add(stats->malformedPackets, 1);
+        return false;
+    }
+
+    if (set < nextReliableSet)
+    {
+        // retransmission of a set that has already been delivered
+        packetPool.emplace(std::move(packet));
+        TransportStats::add(stats->latePackets, 1);
+        return false;
+    }
+
+    auto& reliableSet = reliableSets[set];
+    if (reliableSet.abandoned || (reliableSet.packetSet && reliableSet.packetSet->complete()))
+    {
+        packetPool.emplace(std::move(packet));
+        TransportStats::add(stats->latePackets, 1);
+        return false;
+    }
+
+    if (!reliableSet.packetSet) reliableSet.packetSet = createPacketSet();
+    reliableSet.lastPacketTime = std::chrono::steady_clock::now();
+
+    auto& packetSet = *reliableSet.packetSet;
+    uint32_t numPackets = packetSet.numDataPackets + packetSet.numParityPackets;
+    bool complete = packetSet.add(std::move(packet));
+
+    // only give up on a set once retransmission requests stop being answered
+    if (packetSet.numDataPackets + packetSet.numParityPackets > numPackets) reliableSet.numNacks = 0;
+
+    if (complete)
+    {
+        deliverReliableSets();
+    }
+    else if (packetIndex > 0 && (packetIndex - 1) < packetSet.packetCount && packetSet.packets.count(packetIndex - 1) == 0)
+    {
+        // packets are sent in order so a gap means the preceding packets have been lost, request them without waiting for the set to go quiet
+        requestRetransmission(set, reliableSet, packetIndex);
+    }
+
+    // reliable PacketSet are passed to completedPacketSets by deliverReliableSets() so they aren't handled by completed()
+    return false;
+}
+
+void PacketReceiver::requestRetransmission(uint64_t set, ReliableSet& reliableSet, uint32_t endIndex)
+{
+    if (!nackBroadcaster) return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - reliableSet.lastNackTime).count() < nackInterval) return;
+
+    // when nothing has been recieved for the set its size isn't known, so request its first packet, the rest are requested once its header arrives
+    std::vector<uint32_t> missing;
+    if (reliableSet.packetSet && reliableSet.packetSet->packetCount > 0) reliableSet.packetSet->missingPackets(endIndex, missing);
+    else missing.push_back(0);
+
+    if (missing.empty()) return;
+    if (missing.size() > maxRequestedPackets) missing.resize(maxRequestedPackets);
+
+    reliableSet.lastNackTime = now;
+    ++reliableSet.numNacks;
+
+    Nack nack;
+    nack.set = set;
+
+    for(std::size_t i = 0; i < missing.size(); i += Nack::MAX_INDICES)
+    {
+        nack.numIndices = static_cast<uint32_t>(std::min<std::size_t>(Nack::MAX_INDICES, missing.size() - i));
+        std::memcpy(nack.packetIndices, missing.data() + i, nack.numIndices * sizeof(uint32_t));
+        nackBroadcaster->broadcast(&nack, nack.size());
+        TransportStats::add(stats->nacksSent, 1);
+    }
+}
+
+void PacketReceiver::requestRetransmissions()
+{
+    if (reliableSetCount == 0) return;
+
+    // abandon sets too far behind the sender to be recovered, such as all the earlier sets when joining late
+    if (reliableSetCount > nextReliableSet + maxPendingReliableSets)
+    {
+        uint64_t firstSet = reliableSetCount - maxPendingReliableSets;
+        std::cerr<<"PacketReceiver abandoning reliable sets "<<nextReliableSet<<" to "<<firstSet<<std::endl;
+
+        auto end = reliableSets.lower_bound(firstSet);
+        for(auto itr = reliableSets.begin(); itr != end; ++itr)
         {
-            //std::cout<<"Reusing a PacketSet from the pool."<<std::endl;
-            packetSetMap[set] = std::move(packetSetPool.top());
-            packetSetPool.pop();
+            recycle(std::move(itr->second.packetSet));
         }
-        else
+        TransportStats::add(stats->reliableSetsAbandoned, firstSet - nextReliableSet);
+        reliableSets.erase(reliableSets.begin(), end);
+        nextReliableSet = firstSet;
+    }
+
+    if (!nackBroadcaster) return;
+
+    auto now = std::chrono::steady_clock::now();
+
+    // sets that the sender has announced but that no packets have been recieved for
+    for(uint64_t set = nextReliableSet; set < reliableSetCount; ++set)
+    {
+        if (reliableSets.count(set) == 0) reliableSets[set].lastPacketTime = now;
+    }
+
+    for(auto& [set, reliableSet] : reliableSets)
+    {
+        if (reliableSet.abandoned || (reliableSet.packetSet && reliableSet.packetSet->complete())) continue;
+
+        if (reliableSet.numNacks >= maxNacks)
+        {
+            std::cerr<<"PacketReceiver abandoning reliable set "<<set<<" after "<<reliableSet.numNacks<<" retransmission requests."<<std::endl;
+            reliableSet.abandoned = true;
+            recycle(std::move(reliableSet.packetSet));
+            TransportStats::add(stats->reliableSetsAbandoned, 1);
+            continue;
+        }
+
+        // the tail of a set may still be in flight so is only requested once no packets have arrived for nackInterval
+        if (std::chrono::duration<double>(now - reliableSet.lastPacketTime).count() >= nackInterval)
         {
-            //std::cout<<"Creating a new PacketSet."<<std::endl;
-            packetSetMap[set] = std::unique_ptr<PacketSet>(new PacketSet);
+            requestRetransmission(set, reliableSet, std::numeric_limits<uint32_t>::max());
         }
     }
-    return packetSetMap[set]->add(std::move(packet));
+
+    deliverReliableSets();
 }
 
-vsg::ref_ptr<vsg::Object> PacketReceiver::receive()
+void PacketReceiver::deliverReliableSets()
 {
-    auto first_packet = createPacket();
-    unsigned int first_size = receiver->recieve(&(*first_packet), sizeof(Packet));
-    if (first_size == 0)
+    auto itr = reliableSets.begin();
+    while(itr != reliableSets.end() && itr->first == nextReliableSet)
     {
-        packetPool.emplace(std::move(first_packet));
-        return {};
-    }
+        auto& reliableSet = itr->second;
+        if (reliableSet.abandoned)
+        {
+            recycle(std::move(reliableSet.packetSet));
+        }
+        else if (reliableSet.packetSet && reliableSet.packetSet->complete())
+        {
+            TransportStats::add(stats->packetSetsCompleted, 1);
+            stats->recordAssemblyLatency(std::chrono::duration<double>(std::chrono::steady_clock::now() - reliableSet.packetSet->firstPacketTime).count());
+            completedPacketSets.push_back(std::move(reliableSet.packetSet));
+        }
+        else
+        {
+            break;
+        }
 
-    uint64_t set = first_packet->header.set;
-    if (add(std::move(first_packet)))
-    {
-        return completed(set);
+        itr = reliableSets.erase(itr);
+        ++nextReliableSet;
     }
+}
 
-    while(true)
+std::unique_ptr<PacketSet> PacketReceiver::receivePacketSet()
+{
+    while(completedPacketSets.empty())
     {
-        auto packet = createPacket();
-        unsigned int size = receiver->recieve(&(*packet), sizeof(Packet));
-        if (size == 0)
+        // make sure every slot in the batch has a packet to recieve into
+        batchPackets.resize(batchSize);
+        batchBuffers.resize(batchSize);
+        for(std::size_t i = 0; i < batchSize; ++i)
         {
-            packetPool.emplace(std::move(packet));
-            return {};
+            auto& packet = batchPackets[i];
+            if (!packet) packet = createPacket();
+            packet->reserve(dataSize);
+
+            auto& buffer = batchBuffers[i];
+            buffer.header = &(packet->header);
+            buffer.headerSize = sizeof(Packet::Header);
+            buffer.data = packet->data.data();
+            buffer.dataSize = static_cast<unsigned int>(packet->data.size());
+            buffer.receivedSize = 0;
         }
 
-        set = packet->header.set;
-        if (add(std::move(packet)))
+        unsigned int count = receiver->recieve(batchBuffers);
+        if (count == 0) TransportStats::add(stats->socketTimeouts, 1);
+
+        for(unsigned int i = 0; i < count; ++i)
         {
-            return completed(set);
+            TransportStats::add(stats->packetsReceived, 1);
+            TransportStats::add(stats->bytesReceived, batchBuffers[i].receivedSize);
+
+            // ignore truncated datagrams, leaving the packet in place to be reused by the next batch
+            if (batchBuffers[i].receivedSize < sizeof(Packet::Header))
+            {
+                TransportStats::add(stats->truncatedPackets, 1);
+                continue;
+            }
+
+            // the header is only trusted once it's consistent with the datagram it arrived in
+            if (batchBuffers[i].receivedSize != sizeof(Packet::Header) + batchPackets[i]->header.packetSize || !batchPackets[i]->valid())
+            {
+                TransportStats::add(stats->malformedPackets, 1);
+                continue;
+            }
+
+            uint64_t set = batchPackets[i]->header.set;
+            if (add(std::move(batchPackets[i])))
+            {
+                if (auto packetSet = completed(set)) completedPacketSets.push_back(std::move(packetSet));
+            }
         }
+
+        // follow up on reliable sets with missing packets, including when the socket times out
+        requestRetransmissions();
+
+        if (count == 0 && completedPacketSets.empty()) return {};
     }
 
-    return {};
+    auto packetSet = std::move(completedPacketSets.front());
+    completedPacketSets.pop_front();
+    return packetSet;
+}
+
+vsg::ref_ptr<vsg::Object> PacketReceiver::receive()
+{
+    auto packetSet = receivePacketSet();
+    if (!packetSet) return {};
+
+    auto object = reader.read(*packetSet);
+
+    recycle(std::move(packetSet));
+
+    return object;
 }
@@ -1,18 +1,34 @@
 #pragma once
 
+#include <chrono>
+#include <deque>
+#include <list>
 #include <map>
 #include <stack>
 #include <memory>
+#include <set>
+#include <streambuf>
+#include <vector>
 
 #include "Broadcaster.h"
+#include "Codec.h"
+#include "Hash.h"
 #include "Receiver.h"
+#include "TransportStats.h"
 
 
-const uint64_t DATA_SIZE = 32768 - 40;
+// largest UDP payload that can be sent over IPv4
+const uint64_t MAX_DATAGRAM_SIZE = 65507;
+
+// datagram size used when the network MTU can't be determined
+const uint64_t DEFAULT_DATAGRAM_SIZE = 32768;
+
+// combined size of the IPv4 and UDP headers that precede each datagram
+const uint64_t IP_UDP_HEADER_SIZE = 28;
 
 struct Packet
 {
-    Packet();
+    explicit Packet(uint64_t dataCapacity = DEFAULT_DATAGRAM_SIZE);
     ~Packet();
 
     struct Header
@@ -23,12 +39,69 @@ struct Packet
         uint32_t packetCount = 0;
 
         uint32_t packetIndex = 0;
-        uint64_t packetSize = 0;
+        uint32_t packetSize = 0;
+
+        // size of the data in every data packet except the last, chosen by the sender to suit the network MTU
+        uint32_t packetDataSize = 0;
 
         uint64_t hash = 0;
+
+        // when non zero each group of parityGroupSize data packets is followed by an XOR parity packet,
+        // parity packets have a packetIndex >= packetCount.
+        uint32_t parityGroupSize = 0;
+
+        // Codec used to compress the payload
+        uint32_t codec = CODEC_NONE;
+
+        enum Flags : uint32_t
+        {
+            // PacketSet sent on the reliable channel, set is the reliable sequence number and lost packets are requested again with a Nack.
+            RELIABLE = 1 << 0
+        };
+
+        uint32_t flags = 0;
+
+        // number of reliable PacketSet sent so far, carried by every packet so receivers can detect reliable PacketSet that have been lost entirely.
+        uint64_t reliableSetCount = 0;
     } header;
 
-    uint8_t data[DATA_SIZE];
+    // variable length storage so the packet size can be matched to the network
+    std::vector<uint8_t> data;
+
+    void reserve(uint64_t dataCapacity)
+    {
+        if (data.size() < dataCapacity) data.resize(dataCapacity);
+    }
+
+    // number of parity packets that follow the data packets of the PacketSet
+    uint64_t numParityPackets() const { return header.parityGroupSize > 0 ? (static_cast<uint64_t>(header.packetCount) + header.parityGroupSize - 1) / header.parityGroupSize : 0; }
+
+    // check a recieved packet's header is self consistent and describes data that fits within the packet.
+    bool valid() const;
+};
+
+// largest data size that can be carried by a single datagram
+const uint64_t MAX_DATA_SIZE = MAX_DATAGRAM_SIZE - sizeof(Packet::Header);
+
+// compute the data size of each packet so that datagrams fit within the MTU, avoiding IP fragmentation.
+// An mtu of 0, or one too small to carry the packet header, selects DEFAULT_DATAGRAM_SIZE.
+uint64_t computePacketDataSize(uint32_t mtu);
+
+// request from a receiver for the sender to retransmit packets of a reliable PacketSet that have been lost.
+struct Nack
+{
+    static constexpr uint32_t MAGIC = 0x4e41434b; // "NACK"
+    static constexpr uint32_t MAX_INDICES = 256;
+
+    uint32_t magic = MAGIC;
+
+    // number of entries in packetIndices
+    uint32_t numIndices = 0;
+    uint64_t set = 0;
+    uint32_t packetIndices[MAX_INDICES];
+
+    // size of the message to send, only the used packetIndices are sent
+    unsigned int size() const { return static_cast<unsigned int>(sizeof(Nack) - sizeof(packetIndices) + numIndices * sizeof(uint32_t)); }
 };
 
 struct PacketSet
@@ -37,6 +110,18 @@ struct PacketSet
     std::map<uint32_t, std::unique_ptr<Packet>> packets;
     std::stack<std::unique_ptr<Packet>> pool;
 
+    // data size of the packets created when sending
+    uint64_t dataSize = DEFAULT_DATAGRAM_SIZE - sizeof(Packet::Header);
+
+    // tallies of the packets recieved so far, used to determine when the set is complete or recoverable
+    uint32_t packetCount = 0;
+    uint32_t parityGroupSize = 0;
+    uint32_t numDataPackets = 0;
+    uint32_t numParityPackets = 0;
+
+    // arrival time of the first packet recieved, used to measure assembly latency
+    std::chrono::steady_clock::time_point firstPacketTime;
+
     std::unique_ptr<Packet> takePacketFromPool()
     {
         if (!pool.empty())
@@ -54,38 +139,228 @@ struct PacketSet
     std::unique_ptr<Packet> createPacket()
     {
         auto packet = takePacketFromPool();
-        if (packet) return packet;
-        else return std::unique_ptr<Packet>(new Packet);
+        if (packet)
+        {
+            packet->reserve(dataSize);
+            return packet;
+        }
+        else return std::unique_ptr<Packet>(new Packet(dataSize));
     }
 
     void clear();
     bool add(std::unique_ptr<Packet> packet);
 
+    // copy str into packets, assigning the content hash of str to each packet header
     void copy(const std::string& str);
+
+    // assemble the packets into a string, returns an empty string if the content hash doesn't match the packet headers
     std::string assemble() const;
+
+    // check the data packets match the content hash and total size of the packet headers without assembling them
+    bool verify() const;
+
+    // append an XOR parity packet for every group of groupSize data packets, allowing one lost packet per group to be reconstructed.
+    void addParity(uint32_t groupSize);
+
+    // reconstruct missing data packets from the parity packets, returns true if all data packets are now available.
+    bool reconstruct();
+
+    // true once every data packet is available
+    bool complete() const { return packetCount > 0 && numDataPackets == packetCount; }
+
+    // append the indices of the missing data packets below endIndex to missing.
+    void missingPackets(uint32_t endIndex, std::vector<uint32_t>& missing) const;
+};
+
+// std::streambuf that writes directly into pooled Packet::data buffers of a PacketSet,
+// avoiding the intermediate std::string and per byte copy that PacketSet::copy() requires.
+class PacketStreamBuffer : public std::streambuf
+{
+public:
+    explicit PacketStreamBuffer(PacketSet& in_packetSet);
+
+    // set the packetSize, packetCount, totalSize and hash headers, call once all data has been written.
+    void finish();
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override;
+
+    void nextPacket();
+    void completeCurrentPacket();
+
+    PacketSet& packetSet;
+    Packet* currentPacket = nullptr;
+    uint32_t packetIndex = 0;
+
+    // content hash computed incrementally as each packet is filled
+    Hash64 hash;
+};
+
+// std::streambuf that reads directly from the Packet::data buffers of a complete PacketSet,
+// avoiding assembling the payload into an intermediate std::string.
+class PacketSetInputBuffer : public std::streambuf
+{
+public:
+    explicit PacketSetInputBuffer(const PacketSet& in_packetSet);
+
+protected:
+    int_type underflow() override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+
+    const PacketSet& packetSet;
+    std::map<uint32_t, std::unique_ptr<Packet>>::const_iterator nextPacket;
+    uint32_t packetCount = 0;
+
+    // offset of the current packet within the payload
+    off_type packetStart = 0;
 };
 
 struct PacketBroadcaster
 {
     vsg::ref_ptr<Broadcaster> broadcaster;
+    vsg::ref_ptr<TransportStats> stats = TransportStats::create();
 
     PacketSet packets;
+    std::vector<Datagram> datagrams;
+
+    // size of the datagrams sent, 0 selects the size automatically from the MTU of the Broadcaster's network interface.
+    uint64_t datagramSize = 0;
+
+    // number of data packets protected by each parity packet, 0 disables parity packets.
+    uint32_t parityGroupSize = 0;
+
+    // compression applied to the serialized object, compression falls back to the streaming path when CODEC_NONE.
+    Codec codec = CODEC_NONE;
+    int compressionLevel = 0;
+    std::string compressed;
 
+    // Reliable channel for large transfers such as scene graph uploads, each PacketSet sent by broadcastReliable() is kept in a retransmit window
+    // so that packets reported lost by receivers via the nackReceiver can be sent again. Set nackReceiver's timeout to 0 so processNacks() doesn't block.
+    vsg::ref_ptr<Receiver> nackReceiver;
+    std::size_t retransmitWindowSize = 4;
+    std::deque<std::unique_ptr<PacketSet>> retransmitWindow;
+    uint64_t reliableSetCount = 0;
+
+    // The reliable channel is paced with a token bucket so that large transfers, and the retransmissions requested for them, don't overflow
+    // the receivers' socket buffers. reliableSendRate is in bytes per second with up to reliableBurstSize bytes sent at once, 0 disables pacing.
+    double reliableSendRate = 50.0e6;
+    uint64_t reliableBurstSize = 1024 * 1024;
+
+    // unreliable, suitable for per frame data where a lost PacketSet is superseded by the next one.
     void broadcast(uint64_t set, vsg::ref_ptr<vsg::Object> object);
+
+    // reliable, the receivers request retransmission of lost packets and deliver reliable PacketSet in the order sent.
+    // Blocks until the PacketSet has been sent at the reliableSendRate, retransmitting requested packets in between.
+    void broadcastReliable(vsg::ref_ptr<vsg::Object> object);
+
+    // retransmit the packets requested by the Nack recieved since the last call, as many as the reliableSendRate allows with the rest
+    // left for later calls, returns the number of packets retransmitted.
+    std::size_t processNacks();
+
+protected:
+    void serialize(PacketSet& packetSet, uint64_t set, uint32_t flags, vsg::ref_ptr<vsg::Object> object);
+    void send(const PacketSet& packetSet);
+
+    // add the time since the last refill to the sendTokens, and wait until there are tokens available
+    void refillTokens();
+    void waitForTokens();
+
+    double sendTokens = 0.0;
+    std::chrono::steady_clock::time_point lastTokenTime;
+
+    // packets requested by Nack that are yet to be retransmitted
+    std::map<uint64_t, std::set<uint32_t>> pendingRetransmissions;
+
+    // packets of the newest reliable PacketSet sent so far, requests for the packets still to be sent are ignored
+    uint32_t numReliablePacketsSent = 0;
+};
+
+// Converts a completed PacketSet into a vsg::Object.
+// If the payload hash matches the previous PacketSet the previously read object is returned rather than deserialising it again.
+struct PacketSetReader
+{
+    uint64_t lastHash = 0;
+    vsg::ref_ptr<vsg::Object> lastObject;
+
+    vsg::ref_ptr<vsg::Object> read(const PacketSet& packetSet);
 };
 
 struct PacketReceiver
 {
     vsg::ref_ptr<Receiver> receiver;
+    vsg::ref_ptr<TransportStats> stats = TransportStats::create();
 
     std::map<uint64_t, std::unique_ptr<PacketSet>> packetSetMap;
+    std::list<std::unique_ptr<PacketSet>> completedPacketSets;
+
+    // sets already completed, used to discard late packets such as parity packets that weren't required
+    std::list<uint64_t> recentlyCompletedSets;
 
     std::stack<std::unique_ptr<Packet>> packetPool;
     std::stack<std::unique_ptr<PacketSet>> packetSetPool;
 
+    // packets are recieved into buffers large enough for any datagram, as the sender chooses the packet size
+    uint64_t dataSize = MAX_DATA_SIZE;
+
+    // packets and associated buffers that the next batch of datagrams are recieved into
+    std::vector<std::unique_ptr<Packet>> batchPackets;
+    std::vector<DatagramBuffer> batchBuffers;
+    std::size_t batchSize = 64;
+
+    // preallocate packets so that steady state reception doesn't need to allocate
+    void reserve(std::size_t numPackets);
+
     std::unique_ptr<Packet> createPacket();
+    std::unique_ptr<PacketSet> createPacketSet();
     bool add(std::unique_ptr<Packet> packet);
 
-    vsg::ref_ptr<vsg::Object> completed(uint64_t set);
+    // remove the completed PacketSet from the packetSetMap, discarding any older incomplete PacketSet.
+    std::unique_ptr<PacketSet> completed(uint64_t set);
+
+    // return a PacketSet, and the packets it holds, to the pools for reuse.
+    void recycle(std::unique_ptr<PacketSet> packetSet);
+
+    // recieve batches of packets until a PacketSet is completed, returns null on socket timeout.
+    std::unique_ptr<PacketSet> receivePacketSet();
+
+    // Reliable channel, lost packets of reliable PacketSet are requested again from the sender by sending a Nack via the nackBroadcaster,
+    // and completed reliable PacketSet are delivered in the order they were sent. Without a nackBroadcaster lost packets aren't recovered.
+    struct ReliableSet
+    {
+        std::unique_ptr<PacketSet> packetSet;
+        std::chrono::steady_clock::time_point lastPacketTime;
+        std::chrono::steady_clock::time_point lastNackTime;
+        uint32_t numNacks = 0;
+        bool abandoned = false;
+    };
+
+    vsg::ref_ptr<Broadcaster> nackBroadcaster;
+    std::map<uint64_t, ReliableSet> reliableSets;
+    uint64_t nextReliableSet = 0;
+    uint64_t reliableSetCount = 0;
+
+    // minimum time, in seconds, between Nack for the same PacketSet, and the number of Nack sent without any of the requested packets
+    // arriving before a PacketSet is given up on.
+    double nackInterval = 0.05;
+    uint32_t maxNacks = 100;
+
+    // most packets requested at a time for each PacketSet, so a heavily affected PacketSet is recovered over several rounds rather than in one burst.
+    uint32_t maxRequestedPackets = 4096;
+
+    // maximum number of reliable PacketSet tracked behind the latest one announced, older PacketSet are abandoned, such as when a receiver joins late.
+    uint64_t maxPendingReliableSets = 64;
+
+    bool addReliable(std::unique_ptr<Packet> packet);
+
+    // send Nack for the reliable PacketSet with missing packets, for the tail of a PacketSet only once no packets have arrived for nackInterval.
+    void requestRetransmissions();
+    void requestRetransmission(uint64_t set, ReliableSet& reliableSet, uint32_t endIndex);
+
+    // move completed reliable PacketSet to completedPacketSets in sequence.
+    void deliverReliableSets();
+
+    PacketSetReader reader;
+
     vsg::ref_ptr<vsg::Object> receive();
 };
@@ -16,6 +16,7 @@
 *  THE SOFTWARE.
 */
 
+#include <algorithm>
 #include <fcntl.h>
 #include <stdio.h>
 #include <sys/types.h>
@@ -32,6 +33,10 @@
 #    include <sys/uio.h>
 #    include <unistd.h>
 #endif
+#if defined(__linux)
+#    include <net/if.h>
+#    include <sys/ioctl.h>
+#endif
 #include <string.h>
 
 #include "Receiver.h"
@@ -50,6 +55,13 @@ Receiver::Receiver(uint16_t port) :
 #endif
 }
 
+Receiver::Receiver(uint16_t port, const std::string& multicastGroup, const std::string& ifrName) :
+    Receiver(port)
+{
+    _multicastGroup = multicastGroup;
+    _ifr_name = ifrName;
+}
+
 Receiver::~Receiver(void)
 {
 #if defined(_WIN32) && !defined(__CYGWIN__)
@@ -83,32 +95,51 @@ bool Receiver::init(void)
     setsockopt(_so, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
 #endif
 
+    // request a large socket buffer so bursts of packets from large frames aren't dropped before they can be drained, the OS may clamp this.
+    int receiveBufferSize = 16 * 1024 * 1024;
+    setsockopt(_so, SOL_SOCKET, SO_RCVBUF, (const char*)&receiveBufferSize, sizeof(receiveBufferSize));
+
     saddr.sin_family = AF_INET;
     saddr.sin_port = htons(_port);
 #if defined(_WIN32) && !defined(__CYGWIN__)
     saddr.sin_addr.s_addr = htonl(INADDR_ANY);
 #else
-    saddr.sin_addr.s_addr = 0;
+    // binding to the multicast group address ensures only that group's datagrams are delivered,
+    // so walls using different groups on the same port don't see each other's traffic.
+    saddr.sin_addr.s_addr = _multicastGroup.empty() ? 0 : inet_addr(_multicastGroup.c_str());
 #endif
 
-    // set up a 1 second timeout.
-#if defined(_WIN32) && !defined(__CYGWIN__)
-    DWORD tv = 1000; // 1 sec in ms
-    if (setsockopt(_so, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv), sizeof(DWORD)))
+    if (_timeout <= 0.0)
     {
-        perror("setsockopt");
-        return false;
-    }
+        // non blocking, recieve returns immediately when no datagrams are available
+#if defined(_WIN32) && !defined(__CYGWIN__)
+        u_long mode = 1;
+        ioctlsocket(_so, FIONBIO, &mode);
 #else
-    struct timeval tv;
-    tv.tv_sec = 1;
-    tv.tv_usec = 0;
-    if (setsockopt(_so, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)))
-    {
-        perror("setsockopt");
-        return false;
+        fcntl(_so, F_SETFL, fcntl(_so, F_GETFL, 0) | O_NONBLOCK);
+#endif
     }
+    else
+    {
+        // set up the recieve timeout, 1 second by default.
+#if defined(_WIN32) && !defined(__CYGWIN__)
+        DWORD tv = static_cast<DWORD>(_timeout * 1000.0); // in ms
+        if (setsockopt(_so, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv), sizeof(DWORD)))
+        {
+            perror("setsockopt");
+            return false;
+        }
+#else
+        struct timeval tv;
+        tv.tv_sec = static_cast<time_t>(_timeout);
+        tv.tv_usec = static_cast<suseconds_t>((_timeout - static_cast<double>(tv.tv_sec)) * 1e6);
+        if (setsockopt(_so, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)))
+        {
+            perror("setsockopt");
+            return false;
+        }
 #endif
+    }
 
     if (bind(_so, (struct sockaddr*)&saddr, sizeof(saddr)) < 0)
     {
@@ -116,6 +147,33 @@ bool Receiver::init(void)
         return false;
     }
 
+    if (!_multicastGroup.empty())
+    {
+        struct ip_mreq mreq;
+        memset(&mreq, 0, sizeof(mreq));
+        mreq.imr_multiaddr.s_addr = inet_addr(_multicastGroup.c_str());
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+
+#if defined(__linux)
+        if (!_ifr_name.empty())
+        {
+            struct ifreq ifr;
+            memset(&ifr, 0, sizeof(ifr));
+            strncpy(ifr.ifr_name, _ifr_name.c_str(), sizeof(ifr.ifr_name) - 1);
+            if (ioctl(_so, SIOCGIFADDR, &ifr) >= 0)
+            {
+                mreq.imr_interface = ((sockaddr_in*)&ifr.ifr_addr)->sin_addr;
+            }
+        }
+#endif
+
+        if (setsockopt(_so, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&mreq, sizeof(mreq)) < 0)
+        {
+            perror("Receiver::init() - IP_ADD_MEMBERSHIP");
+            return false;
+        }
+    }
+
     _initialized = true;
     return _initialized;
 }
@@ -148,9 +206,9 @@ unsigned int Receiver::recieve(void* buffer, const unsigned int buffer_size)
     if (read_bytes < 0)
     {
         int err = WSAGetLastError();
-        if (err == WSAETIMEDOUT)
+        if (err == WSAETIMEDOUT || err == WSAEWOULDBLOCK)
         {
-            std::cout << "Receiver::sync() : Connection timed out." << std::endl;
+            // timeouts are expected when polling, so aren't reported as errors
             return 0;
         }
 
@@ -174,7 +232,10 @@ unsigned int Receiver::recieve(void* buffer, const unsigned int buffer_size)
 
     if (read_bytes < 0)
     {
-        std::cerr << "Receiver::sync() : " << strerror(errno) << std::endl;
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            std::cerr << "Receiver::sync() : " << strerror(errno) << std::endl;
+        }
         return 0;
     }
 
@@ -182,3 +243,68 @@ unsigned int Receiver::recieve(void* buffer, const unsigned int buffer_size)
 
     return static_cast<unsigned int>(read_bytes);
 }
+
+unsigned int Receiver::recieve(std::vector<DatagramBuffer>& buffers)
+{
+    if (!_initialized) init();
+
+    if (buffers.empty()) return 0;
+
+#if defined(__linux)
+
+    const std::size_t maxBatchSize = 64;
+
+    struct mmsghdr msgs[maxBatchSize];
+    struct iovec iovecs[maxBatchSize][2];
+
+    std::size_t batchSize = std::min(maxBatchSize, buffers.size());
+
+    memset(msgs, 0, sizeof(struct mmsghdr) * batchSize);
+    for (std::size_t i = 0; i < batchSize; ++i)
+    {
+        auto& buffer = buffers[i];
+        iovecs[i][0].iov_base = buffer.header;
+        iovecs[i][0].iov_len = buffer.headerSize;
+        iovecs[i][1].iov_base = buffer.data;
+        iovecs[i][1].iov_len = buffer.dataSize;
+
+        msgs[i].msg_hdr.msg_iov = iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+    }
+
+    // MSG_WAITFORONE blocks, subject to the SO_RCVTIMEO timeout, until the first datagram arrives then returns all that are immediately available
+    int result = recvmmsg(_so, msgs, static_cast<unsigned int>(batchSize), MSG_WAITFORONE, nullptr);
+    if (result < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            std::cerr << "Receiver::recieve() : " << strerror(errno) << std::endl;
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < result; ++i)
+    {
+        buffers[i].receivedSize = msgs[i].msg_len;
+    }
+
+    return static_cast<unsigned int>(result);
+
+#else
+
+    // no batched recieve available so recieve a single datagram via a scratch buffer
+    auto& buffer = buffers.front();
+
+    std::vector<uint8_t> scratch(buffer.headerSize + buffer.dataSize);
+    unsigned int size = recieve(scratch.data(), static_cast<unsigned int>(scratch.size()));
+    if (size == 0) return 0;
+
+    unsigned int headerSize = std::min(size, buffer.headerSize);
+    memcpy(buffer.header, scratch.data(), headerSize);
+    memcpy(buffer.data, scratch.data() + headerSize, size - headerSize);
+    buffer.receivedSize = size;
+
+    return 1;
+
+#endif
+}
@@ -34,14 +34,39 @@
 
 #include <vsg/core/Inherit.h>
 
+#include <string>
+#include <vector>
+
+// scatter/gather description of where to place the header and data of a received datagram
+struct DatagramBuffer
+{
+    void* header = nullptr;
+    unsigned int headerSize = 0;
+    void* data = nullptr;
+    unsigned int dataSize = 0;
+    unsigned int receivedSize = 0;
+};
+
 class Receiver : public vsg::Inherit<vsg::Object, Receiver>
 {
 public:
     Receiver(uint16_t port);
 
+    // join the multicast group address, such as "239.0.0.1", on the named interface, or on the default interface if ifrName is empty.
+    Receiver(uint16_t port, const std::string& multicastGroup, const std::string& ifrName = {});
+
     // Sync does a blocking wait to recieve next message
     unsigned int recieve(void* buffer, const unsigned int buffer_size);
 
+    // Blocking wait to recieve at least one datagram, then drains as many as are available into buffers using recvmmsg() where supported.
+    // Returns the number of datagrams recieved, 0 on timeout.
+    unsigned int recieve(std::vector<DatagramBuffer>& buffers);
+
+    // set how long, in seconds, the blocking recieve calls wait before timing out, a timeout of 0 makes recieve non blocking.
+    // Must be called before the first recieve.
+    void setTimeout(double seconds) { _timeout = seconds; }
+    double getTimeout() const { return _timeout; }
+
 private:
     bool init(void);
 
@@ -58,4 +83,8 @@ private:
 
     bool _initialized;
     short _port;
+    double _timeout = 1.0;
+
+    std::string _multicastGroup;
+    std::string _ifr_name;
 };
@@ -0,0 +1,183 @@
+#include "ReceiverThread.h"
+
+struct ReceiverThread::ReadOperation : public vsg::Inherit<vsg::Operation, ReceiverThread::ReadOperation>
+{
+    ReadOperation(vsg::observer_ptr<ReceiverThread> in_receiverThread, uint64_t in_sequence, std::unique_ptr<PacketSet> in_packetSet) :
+        receiverThread(in_receiverThread),
+        sequence(in_sequence),
+        packetSet(std::move(in_packetSet)) {}
+
+    vsg::observer_ptr<ReceiverThread> receiverThread;
+    uint64_t sequence;
+    std::unique_ptr<PacketSet> packetSet;
+
+    void run() override
+    {
+        vsg::ref_ptr<ReceiverThread> rt(receiverThread);
+        if (!rt) return;
+
+        auto& header = packetSet->packets.begin()->second->header;
+        uint64_t hash = header.hash;
+        bool reliable = (header.flags & Packet::Header::RELIABLE) != 0;
+
+        // duplicates are detected before dispatch so each operation uses its own reader
+        PacketSetReader reader;
+        auto object = reader.read(*packetSet);
+
+        std::scoped_lock lock(rt->_readyMutex);
+        auto& entry = rt->_readyEntries[sequence];
+        entry.packetSet = std::move(packetSet);
+        entry.object = object;
+        entry.hash = hash;
+        entry.reliable = reliable;
+
+        // only payloads that were read successfully can be used to skip reading later duplicates
+        auto& lastRead = rt->_lastRead[reliable ? 1 : 0];
+        if (object && (!lastRead.valid || sequence > lastRead.sequence))
+        {
+            lastRead.valid = true;
+            lastRead.sequence = sequence;
+            lastRead.hash = hash;
+        }
+    }
+};
+
+ReceiverThread::ReceiverThread(vsg::ref_ptr<Receiver> receiver, std::size_t numPreallocatedPackets, std::size_t queueSize, std::size_t numReadThreads) :
+    _queueSize(queueSize),
+    _completedQueue(queueSize),
+    _recycleQueue(queueSize)
+{
+    _packetReceiver.receiver = receiver;
+    _packetReceiver.reserve(numPreallocatedPackets);
+
+    if (numReadThreads > 0) _readThreads = vsg::OperationThreads::create(static_cast<uint32_t>(numReadThreads));
+}
+
+ReceiverThread::~ReceiverThread()
+{
+    stop();
+}
+
+void ReceiverThread::start()
+{
+    if (_active.exchange(true)) return;
+
+    _thread = std::thread([this]() { run(); });
+}
+
+void ReceiverThread::stop()
+{
+    // the network thread will notice the change within one socket timeout period
+    _active = false;
+    if (_thread.joinable()) _thread.join();
+}
+
+void ReceiverThread::run()
+{
+    while (_active)
+    {
+        // reclaim PacketSet the consumer has finished with
+        std::unique_ptr<PacketSet> packetSet;
+        while (_recycleQueue.pop(packetSet))
+        {
+            _packetReceiver.recycle(std::move(packetSet));
+        }
+
+        packetSet = _packetReceiver.receivePacketSet();
+        if (!packetSet) continue;
+
+        if (_readThreads)
+        {
+            dispatch(std::move(packetSet));
+        }
+        else if (!_completedQueue.push(std::move(packetSet)))
+        {
+            // consumer has fallen behind so drop this PacketSet rather than block the network thread
+            _packetReceiver.recycle(std::move(packetSet));
+        }
+    }
+}
+
+void ReceiverThread::dispatch(std::unique_ptr<PacketSet> packetSet)
+{
+    auto& header = packetSet->packets.begin()->second->header;
+    bool reliable = (header.flags & Packet::Header::RELIABLE) != 0;
+    uint64_t hash = header.hash;
+
+    // consumer has fallen behind so drop this PacketSet rather than queue without limit, reliable PacketSet must always be delivered.
+    if (!reliable && _numInFlight >= _queueSize)
+    {
+        _packetReceiver.recycle(std::move(packetSet));
+        return;
+    }
+
+    uint64_t sequence = _nextSequence++;
+    ++_numInFlight;
+
+    {
+        std::scoped_lock lock(_readyMutex);
+        auto& lastRead = _lastRead[reliable ? 1 : 0];
+        if (lastRead.valid && hash == lastRead.hash)
+        {
+            // identical payload to the last one read on this channel so skip deserialisation
+            auto& entry = _readyEntries[sequence];
+            entry.packetSet = std::move(packetSet);
+            entry.hash = hash;
+            entry.reliable = reliable;
+            entry.duplicate = true;
+            return;
+        }
+    }
+
+    _readThreads->add(ReadOperation::create(vsg::observer_ptr<ReceiverThread>(this), sequence, std::move(packetSet)));
+}
+
+vsg::ref_ptr<vsg::Object> ReceiverThread::receive()
+{
+    if (_readThreads)
+    {
+        // take the deserialised objects in sequence, skipping any that failed to read
+        while (true)
+        {
+            ReadyEntry entry;
+            {
+                std::scoped_lock lock(_readyMutex);
+                auto itr = _readyEntries.find(_nextReadySequence);
+                if (itr == _readyEntries.end()) return {};
+
+                entry = std::move(itr->second);
+                _readyEntries.erase(itr);
+            }
+
+            ++_nextReadySequence;
+            --_numInFlight;
+
+            auto& lastObject = _lastObjects[entry.reliable ? 1 : 0];
+            if (entry.duplicate)
+            {
+                // the read a duplicate was matched against can complete after a later PacketSet of the channel is delivered, in which case read it here
+                if (lastObject.object && lastObject.hash == entry.hash) entry.object = lastObject.object;
+                else entry.object = _reader.read(*entry.packetSet);
+            }
+
+            _recycleQueue.push(std::move(entry.packetSet));
+
+            if (entry.object)
+            {
+                lastObject.hash = entry.hash;
+                lastObject.object = entry.object;
+                return entry.object;
+            }
+        }
+    }
+
+    std::unique_ptr<PacketSet> packetSet;
+    if (!_completedQueue.pop(packetSet)) return {};
+
+    auto object = _reader.read(*packetSet);
+
+    // if the recycle queue is full the PacketSet and its packets are simply freed
+    _recycleQueue.push(std::move(packetSet));
+
+    return object;
+}
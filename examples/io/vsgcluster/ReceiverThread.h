@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <vsg/threading/OperationThreads.h>
+
+#include "Packet.h"
+#include "SPSCQueue.h"
+
+////////////////////////////////////////////////////////////
+// ReceiverThread.h
+//
+// Class definition for recieving packets on a dedicated network thread so that the
+// frame loop never blocks on the socket. Completed PacketSet are passed to the
+// render thread via a lock-free queue, and returned to the network thread for reuse
+// once they have been read. Optionally the completed PacketSet are deserialised on a
+// pool of worker threads so that large objects don't stall the frame loop.
+//
+
+class ReceiverThread : public vsg::Inherit<vsg::Object, ReceiverThread>
+{
+public:
+    // when numReadThreads is 0 PacketSet are deserialised by receive() on the consumer thread.
+    ReceiverThread(vsg::ref_ptr<Receiver> receiver, std::size_t numPreallocatedPackets = 256, std::size_t queueSize = 16, std::size_t numReadThreads = 0);
+
+    // enable retransmission requests for lost packets of reliable PacketSet, must be called before start().
+    void setNackBroadcaster(vsg::ref_ptr<Broadcaster> nackBroadcaster) { _packetReceiver.nackBroadcaster = nackBroadcaster; }
+
+    // counters updated by the network thread
+    vsg::ref_ptr<TransportStats> getStats() const { return _packetReceiver.stats; }
+
+    void start();
+    void stop();
+
+    // Non blocking, returns the next completed object if one is available, otherwise null.
+    // Must only be called from a single consumer thread.
+    vsg::ref_ptr<vsg::Object> receive();
+
+protected:
+    virtual ~ReceiverThread();
+
+    void run();
+
+    // pass a completed PacketSet to the read threads, on the network thread.
+    void dispatch(std::unique_ptr<PacketSet> packetSet);
+
+    struct ReadOperation;
+
+    PacketReceiver _packetReceiver;
+    std::size_t _queueSize;
+
+    // only used from the consumer thread
+    PacketSetReader _reader;
+
+    // network thread -> consumer thread
+    SPSCQueue<std::unique_ptr<PacketSet>> _completedQueue;
+
+    // consumer thread -> network thread
+    SPSCQueue<std::unique_ptr<PacketSet>> _recycleQueue;
+
+    // deserialised objects are passed from the read threads to the consumer thread in the order their PacketSet completed.
+    struct ReadyEntry
+    {
+        std::unique_ptr<PacketSet> packetSet;
+        vsg::ref_ptr<vsg::Object> object;
+
+        uint64_t hash = 0;
+        bool reliable = false;
+
+        // same payload as a PacketSet already read on the same channel so wasn't deserialised again
+        bool duplicate = false;
+    };
+
+    // the reliable and unreliable channels are deduplicated separately, so these are indexed by whether the PacketSet is reliable
+    struct LastRead
+    {
+        bool valid = false;
+        uint64_t sequence = 0;
+        uint64_t hash = 0;
+    };
+
+    struct LastObject
+    {
+        uint64_t hash = 0;
+        vsg::ref_ptr<vsg::Object> object;
+    };
+
+    vsg::ref_ptr<vsg::OperationThreads> _readThreads;
+    std::mutex _readyMutex;
+    std::map<uint64_t, ReadyEntry> _readyEntries;
+    std::atomic<uint64_t> _numInFlight{0};
+
+    // the most recent PacketSet successfully read on each channel, guarded by _readyMutex
+    LastRead _lastRead[2];
+
+    // only used from the network thread
+    uint64_t _nextSequence = 0;
+
+    // only used from the consumer thread
+    uint64_t _nextReadySequence = 0;
+    LastObject _lastObjects[2];
+
+    std::atomic_bool _active{false};
+    std::thread _thread;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+// Lock-free, fixed capacity, single producer/single consumer queue used to pass data between the network and render threads.
+// push() must only be called from the producer thread and pop() only from the consumer thread.
+template<typename T>
+class SPSCQueue
+{
+public:
+    explicit SPSCQueue(std::size_t capacity) :
+        _buffer(capacity + 1) {}
+
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    // returns false, leaving value untouched, if the queue is full.
+    bool push(T&& value)
+    {
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        std::size_t next = increment(tail);
+        if (next == _head.load(std::memory_order_acquire)) return false;
+
+        _buffer[tail] = std::move(value);
+        _tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // returns false if the queue is empty.
+    bool pop(T& value)
+    {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) return false;
+
+        value = std::move(_buffer[head]);
+        _head.store(increment(head), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+
+    std::size_t capacity() const { return _buffer.size() - 1; }
+
+protected:
+    std::size_t increment(std::size_t index) const { return (index + 1) % _buffer.size(); }
+
+    std::vector<T> _buffer;
+
+    // keep the producer and consumer indices on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<std::size_t> _head{0};
+    alignas(64) std::atomic<std::size_t> _tail{0};
+};
@@ -0,0 +1,351 @@
+#include "SharedMemory.h"
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+#    define NOMINMAX
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <random>
+#include <thread>
+
+#include <vsg/io/VSG.h>
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// SharedMemory
+//
+SharedMemory::SharedMemory(const std::string& name, std::size_t size) :
+    _name(name),
+    _owner(size > 0)
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    if (_owner)
+    {
+        _handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size & 0xffffffff), _name.c_str());
+    }
+    else
+    {
+        _handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, _name.c_str());
+    }
+    if (!_handle) return;
+
+    _data = MapViewOfFile(_handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!_data) return;
+
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(_data, &info, sizeof(info));
+    _size = _owner ? size : info.RegionSize;
+#else
+    // POSIX shared memory names must start with a /
+    if (_name.empty() || _name[0] != '/') _name.insert(0, "/");
+
+    int fd = -1;
+    if (_owner)
+    {
+        shm_unlink(_name.c_str());
+        fd = shm_open(_name.c_str(), O_CREAT | O_RDWR, 0666);
+        if (fd < 0)
+        {
+            perror("SharedMemory shm_open");
+            return;
+        }
+
+        if (ftruncate(fd, static_cast<off_t>(size)) < 0)
+        {
+            perror("SharedMemory ftruncate");
+            close(fd);
+            return;
+        }
+    }
+    else
+    {
+        // the broadcaster may not have created the region yet so failure isn't reported
+        fd = shm_open(_name.c_str(), O_RDWR, 0666);
+        if (fd < 0) return;
+
+        struct stat sb;
+        if (fstat(fd, &sb) < 0 || sb.st_size == 0)
+        {
+            close(fd);
+            return;
+        }
+        size = static_cast<std::size_t>(sb.st_size);
+    }
+
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (ptr == MAP_FAILED)
+    {
+        perror("SharedMemory mmap");
+        return;
+    }
+
+    _data = ptr;
+    _size = size;
+#endif
+}
+
+SharedMemory::~SharedMemory()
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    if (_data) UnmapViewOfFile(_data);
+    if (_handle) CloseHandle(_handle);
+#else
+    if (_data) munmap(_data, _size);
+    if (_owner) shm_unlink(_name.c_str());
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// SharedMemoryRing
+//
+bool SharedMemoryRing::create(const std::string& name, uint64_t numSlots, uint64_t slotSize)
+{
+    static_assert(sizeof(Header) <= 64, "SharedMemoryRing::Header must fit before the slot table");
+
+    memory = SharedMemory::create(name, requiredSize(numSlots, slotSize));
+    if (!memory->valid()) return false;
+
+    auto bytes = static_cast<uint8_t*>(memory->data());
+    header = new (bytes) Header;
+    slots = reinterpret_cast<Slot*>(bytes + slotTableOffset());
+    data = bytes + dataOffset(numSlots);
+
+    header->version = VERSION;
+    header->numSlots = numSlots;
+    header->slotSize = slotSize;
+    header->writeCount.store(0, std::memory_order_relaxed);
+
+    // the creation time alone can collide for broadcasters started together so is combined with a random value
+    uint64_t generation = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count()) ^ (static_cast<uint64_t>(std::random_device{}()) << 32);
+    header->generation.store(generation, std::memory_order_relaxed);
+
+    for (uint64_t i = 0; i < numSlots; ++i)
+    {
+        auto s = new (&slots[i]) Slot;
+        s->sequence.store(0, std::memory_order_relaxed);
+        s->set = 0;
+        s->size = 0;
+    }
+
+    header->magic.store(MAGIC, std::memory_order_release);
+
+    return true;
+}
+
+bool SharedMemoryRing::open(const std::string& name)
+{
+    auto region = SharedMemory::create(name);
+    if (!region->valid() || region->size() < slotTableOffset()) return false;
+
+    auto bytes = static_cast<uint8_t*>(region->data());
+    auto candidate = reinterpret_cast<Header*>(bytes);
+    if (candidate->magic.load(std::memory_order_acquire) != MAGIC) return false;
+    if (candidate->version != VERSION)
+    {
+        static bool warned = false;
+        if (!warned) std::cerr << "SharedMemoryRing::open() " << name << " has version " << candidate->version << ", expected " << VERSION << std::endl;
+        warned = true;
+        return false;
+    }
+    if (region->size() < requiredSize(candidate->numSlots, candidate->slotSize)) return false;
+
+    memory = region;
+    header = candidate;
+    slots = reinterpret_cast<Slot*>(bytes + slotTableOffset());
+    data = bytes + dataOffset(header->numSlots);
+
+    return true;
+}
+
+namespace
+{
+    // fixed size std::streambuf over a slot, writes fail once the slot is full
+    struct SlotStreamBuffer : public std::streambuf
+    {
+        SlotStreamBuffer(char* begin, std::size_t size) { setp(begin, begin + size); }
+        std::size_t size() const { return static_cast<std::size_t>(pptr() - pbase()); }
+    };
+
+    // std::streambuf reading from a block of memory without copying it
+    struct MemoryStreamBuffer : public std::streambuf
+    {
+        MemoryStreamBuffer(char* begin, std::size_t size) { setg(begin, begin, begin + size); }
+    };
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// SharedMemoryBroadcaster
+//
+void SharedMemoryBroadcaster::broadcast(uint64_t set, vsg::ref_ptr<vsg::Object> object)
+{
+    if (!ring.header && !ring.create(name, numSlots, slotSize))
+    {
+        std::cerr << "SharedMemoryBroadcaster::broadcast() unable to create shared memory " << name << std::endl;
+        return;
+    }
+
+    uint64_t count = ring.header->writeCount.load(std::memory_order_relaxed);
+    auto& slot = ring.slot(count);
+
+    // mark the slot as being written so receivers reading the previous contents discard them
+    slot.sequence.store(2 * count + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto options = vsg::Options::create();
+    options->extensionHint = "vsgb";
+
+    SlotStreamBuffer buffer(reinterpret_cast<char*>(ring.slotData(count)), ring.header->slotSize);
+    std::ostream ostr(&buffer);
+    vsg::VSG rw;
+    rw.write(object, ostr, options);
+
+    slot.set = set;
+    slot.size = buffer.size();
+
+    if (ostr.good())
+    {
+        slot.sequence.store(2 * count + 2, std::memory_order_release);
+
+        TransportStats::add(stats->packetSetsSent, 1);
+        TransportStats::add(stats->bytesSent, slot.size);
+    }
+    else
+    {
+        // leaving the sequence odd makes receivers skip this slot
+        std::cerr << "SharedMemoryBroadcaster::broadcast() object too large for slot size of " << ring.header->slotSize << std::endl;
+    }
+
+    ring.header->writeCount.store(count + 1, std::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+//
+// SharedMemoryReceiver
+//
+vsg::ref_ptr<vsg::Object> SharedMemoryReceiver::receive()
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+    while (true)
+    {
+        if (auto object = receiveNext()) return object;
+
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            if (timeout > 0.0) TransportStats::add(stats->socketTimeouts, 1);
+            return {};
+        }
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(pollInterval));
+    }
+}
+
+void SharedMemoryReceiver::attach(SharedMemoryRing& newRing)
+{
+    ring = newRing;
+    generation = ring.header->generation.load(std::memory_order_acquire);
+    lastCheckTime = std::chrono::steady_clock::now();
+
+    // start with the most recent object rather than replaying the whole ring
+    uint64_t writeCount = ring.header->writeCount.load(std::memory_order_acquire);
+    readCount = writeCount > 0 ? writeCount - 1 : 0;
+}
+
+void SharedMemoryReceiver::checkForRestart()
+{
+    // where an existing region is reused, as on Windows while any process has it open, the broadcaster reinitializes it in place
+    bool restarted = ring.header->generation.load(std::memory_order_acquire) != generation;
+
+    // otherwise the broadcaster replaces the region with a new one of the same name, leaving this receiver mapping the old region that's no longer written to
+    auto now = std::chrono::steady_clock::now();
+    if (!restarted && std::chrono::duration<double>(now - lastCheckTime).count() < restartCheckInterval) return;
+    lastCheckTime = now;
+
+    SharedMemoryRing latest;
+    if (!latest.open(name)) return;
+
+    if (restarted || latest.header->generation.load(std::memory_order_acquire) != generation)
+    {
+        std::cerr << "SharedMemoryReceiver broadcaster restarted, reopening " << name << std::endl;
+        attach(latest);
+    }
+}
+
+vsg::ref_ptr<vsg::Object> SharedMemoryReceiver::receiveNext()
+{
+    if (!ring.header)
+    {
+        SharedMemoryRing newRing;
+        if (!newRing.open(name)) return {};
+        attach(newRing);
+    }
+
+    uint64_t writeCount = ring.header->writeCount.load(std::memory_order_acquire);
+
+    // nothing new, so check the broadcaster hasn't been restarted
+    if (readCount >= writeCount)
+    {
+        checkForRestart();
+        writeCount = ring.header->writeCount.load(std::memory_order_acquire);
+    }
+    else
+    {
+        lastCheckTime = std::chrono::steady_clock::now();
+    }
+
+    uint64_t numSlots = ring.header->numSlots;
+
+    while (readCount < writeCount)
+    {
+        // the broadcaster has lapped this receiver so the oldest slots have been overwritten
+        if (writeCount - readCount > numSlots)
+        {
+            TransportStats::add(stats->incompleteSetsDiscarded, writeCount - numSlots - readCount);
+            readCount = writeCount - numSlots;
+        }
+
+        uint64_t count = readCount++;
+        auto& slot = ring.slot(count);
+
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        uint64_t size = slot.size;
+        if (sequence != 2 * count + 2 || size > ring.header->slotSize)
+        {
+            TransportStats::add(stats->incompleteSetsDiscarded, 1);
+            continue;
+        }
+
+        // copy out of the slot then check the broadcaster didn't start overwriting it during the copy
+        buffer.resize(size);
+        std::memcpy(buffer.data(), ring.slotData(count), size);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+        {
+            TransportStats::add(stats->incompleteSetsDiscarded, 1);
+            continue;
+        }
+
+        TransportStats::add(stats->packetSetsCompleted, 1);
+        TransportStats::add(stats->bytesReceived, size);
+
+        MemoryStreamBuffer streamBuffer(buffer.data(), buffer.size());
+        std::istream istr(&streamBuffer);
+        vsg::VSG rw;
+        if (auto object = rw.read(istr)) return object;
+    }
+
+    return {};
+}
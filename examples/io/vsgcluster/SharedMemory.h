@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <vsg/core/Inherit.h>
+
+#include "TransportStats.h"
+
+////////////////////////////////////////////////////////////
+// SharedMemory.h
+//
+// Transport for display processes running on the same host as the master. Objects are serialized
+// into a ring of fixed size slots in a named shared memory region, and read back by any number of
+// receivers without going through the network stack. Each slot is guarded by a sequence lock so
+// receivers detect, and discard, slots that the broadcaster overwrote while they were being read.
+// Each region records a generation that's unique to the broadcaster that created it, so receivers
+// can detect a restarted broadcaster replacing the region and switch over to the new one.
+//
+
+// named region of memory shared between processes
+class SharedMemory : public vsg::Inherit<vsg::Object, SharedMemory>
+{
+public:
+    // when size is non zero the region is created, replacing any existing region of the same name, and removed again on destruction.
+    // when size is 0 an existing region is opened, check valid() to see if it's available.
+    SharedMemory(const std::string& name, std::size_t size = 0);
+
+    bool valid() const { return _data != nullptr; }
+    void* data() const { return _data; }
+    std::size_t size() const { return _size; }
+
+protected:
+    virtual ~SharedMemory();
+
+    std::string _name;
+    bool _owner = false;
+    void* _data = nullptr;
+    std::size_t _size = 0;
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    void* _handle = nullptr;
+#endif
+};
+
+// layout at the start of the shared memory region, followed by the slot table then the slot data
+struct SharedMemoryRing
+{
+    static constexpr uint32_t MAGIC = 0x56534752; // "VSGR"
+    static constexpr uint32_t VERSION = 2;
+
+    struct Header
+    {
+        // set last by the broadcaster once the rest of the region is initialized
+        std::atomic<uint32_t> magic;
+        uint32_t version;
+        uint64_t numSlots;
+        uint64_t slotSize;
+
+        // number of objects written, the next is written to slot writeCount % numSlots
+        std::atomic<uint64_t> writeCount;
+
+        // unique to each create(), changes when a restarted broadcaster recreates the region
+        std::atomic<uint64_t> generation;
+    };
+
+    struct Slot
+    {
+        // sequence lock, 2 * n + 1 while write n is in progress, 2 * n + 2 once it's complete
+        std::atomic<uint64_t> sequence;
+        uint64_t set;
+        uint64_t size;
+        uint64_t padding;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory transport requires lock free 64 bit atomics");
+
+    static std::size_t slotTableOffset() { return 64; }
+    static std::size_t dataOffset(uint64_t numSlots) { return (slotTableOffset() + numSlots * sizeof(Slot) + 63) & ~std::size_t(63); }
+    static std::size_t requiredSize(uint64_t numSlots, uint64_t slotSize) { return dataOffset(numSlots) + numSlots * slotSize; }
+
+    vsg::ref_ptr<SharedMemory> memory;
+    Header* header = nullptr;
+    Slot* slots = nullptr;
+    uint8_t* data = nullptr;
+
+    bool create(const std::string& name, uint64_t numSlots, uint64_t slotSize);
+    bool open(const std::string& name);
+
+    Slot& slot(uint64_t count) { return slots[count % header->numSlots]; }
+    uint8_t* slotData(uint64_t count) { return data + (count % header->numSlots) * header->slotSize; }
+};
+
+struct SharedMemoryBroadcaster
+{
+    std::string name;
+
+    // objects larger than slotSize can't be sent, enough slots are required for receivers to keep up without being overwritten
+    uint64_t numSlots = 8;
+    uint64_t slotSize = 4 * 1024 * 1024;
+
+    SharedMemoryRing ring;
+    vsg::ref_ptr<TransportStats> stats = TransportStats::create();
+
+    void broadcast(uint64_t set, vsg::ref_ptr<vsg::Object> object);
+};
+
+struct SharedMemoryReceiver
+{
+    std::string name;
+
+    // time to wait in receive() for the next object, 0 returns immediately
+    double timeout = 1.0;
+    double pollInterval = 0.0001;
+
+    // time, in seconds, without new objects after which the region is opened again to check whether a restarted broadcaster has replaced it
+    double restartCheckInterval = 1.0;
+
+    SharedMemoryRing ring;
+    uint64_t readCount = 0;
+    uint64_t generation = 0;
+    std::vector<char> buffer;
+    vsg::ref_ptr<TransportStats> stats = TransportStats::create();
+
+    // returns the next object written by the broadcaster, or null on timeout.
+    vsg::ref_ptr<vsg::Object> receive();
+
+protected:
+    vsg::ref_ptr<vsg::Object> receiveNext();
+
+    // switch to ring, starting with its most recent object
+    void attach(SharedMemoryRing& newRing);
+
+    // check whether the broadcaster has been restarted, switching to its new region if so
+    void checkForRestart();
+
+    std::chrono::steady_clock::time_point lastCheckTime;
+};
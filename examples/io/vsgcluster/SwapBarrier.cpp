@@ -0,0 +1,87 @@
+#include "SwapBarrier.h"
+
+#include <vsg/ui/UIEvent.h>
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+
+bool SwapBarrier::wait(uint64_t frameCount)
+{
+    auto startTime = vsg::clock::now();
+
+    bool result = isMaster() ? waitForClients(frameCount) : waitForPresent(frameCount);
+
+    double waitTime = std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startTime).count();
+
+    ++numFrames;
+    if (!result) ++numTimeouts;
+    totalWaitTime += waitTime;
+    maxWaitTime = std::max(maxWaitTime, waitTime);
+
+    return result;
+}
+
+bool SwapBarrier::waitForClients(uint64_t frameCount)
+{
+    // poll with a short socket timeout so the overall barrier timeout is honoured
+    recordedReceiver->setTimeout(pollInterval);
+
+    auto deadline = vsg::clock::now() + std::chrono::duration_cast<vsg::clock::duration>(std::chrono::duration<double>(timeout));
+
+    std::set<uint32_t> recordedClients;
+    while (recordedClients.size() < numClients && vsg::clock::now() < deadline)
+    {
+        SwapBarrierMessage message;
+        if (recordedReceiver->recieve(&message, sizeof(message)) != sizeof(message)) continue;
+
+        // reports for earlier frames are from clients that timed out, so are ignored
+        if (message.magic == SwapBarrierMessage::MAGIC && message.type == SwapBarrierMessage::FRAME_RECORDED && message.frameCount == frameCount)
+        {
+            recordedClients.insert(message.clientID);
+        }
+    }
+
+    // release the clients even on timeout so that the rest of the wall keeps running
+    SwapBarrierMessage present;
+    present.type = SwapBarrierMessage::PRESENT;
+    present.frameCount = frameCount;
+    presentBroadcaster->broadcast(&present, sizeof(present));
+
+    return recordedClients.size() >= numClients;
+}
+
+bool SwapBarrier::waitForPresent(uint64_t frameCount)
+{
+    presentReceiver->setTimeout(pollInterval);
+
+    SwapBarrierMessage recorded;
+    recorded.type = SwapBarrierMessage::FRAME_RECORDED;
+    recorded.frameCount = frameCount;
+    recorded.clientID = clientID;
+    recordedBroadcaster->broadcast(&recorded, sizeof(recorded));
+
+    auto deadline = vsg::clock::now() + std::chrono::duration_cast<vsg::clock::duration>(std::chrono::duration<double>(timeout));
+
+    while (vsg::clock::now() < deadline)
+    {
+        SwapBarrierMessage message;
+        if (presentReceiver->recieve(&message, sizeof(message)) != sizeof(message)) continue;
+
+        // a present for a later frame means this client has fallen behind, so present immediately to catch up
+        if (message.magic == SwapBarrierMessage::MAGIC && message.type == SwapBarrierMessage::PRESENT && message.frameCount >= frameCount)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SwapBarrier::report(std::ostream& out) const
+{
+    out << "SwapBarrier " << (isMaster() ? "master" : "client") << " : frames = " << numFrames
+        << ", timeouts = " << numTimeouts
+        << ", average wait = " << (numFrames > 0 ? totalWaitTime / static_cast<double>(numFrames) : 0.0) << "ms"
+        << ", max wait = " << maxWaitTime << "ms" << std::endl;
+}
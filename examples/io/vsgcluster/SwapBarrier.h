@@ -0,0 +1,71 @@
+#pragma once
+
+#include <iostream>
+
+#include "Broadcaster.h"
+#include "Receiver.h"
+
+////////////////////////////////////////////////////////////
+// SwapBarrier.h
+//
+// Frame synchronised swap barrier so that all the displays of a wall present the same frame together.
+// Each client reports to the master once it has recorded and submitted a frame, the master waits
+// until all the clients have reported then broadcasts a present message, and the clients wait for
+// that message before calling present(). Waits are bounded by a timeout so a stalled or disconnected
+// client degrades to free running rather than hanging the wall.
+//
+
+// small fixed size message exchanged by the SwapBarrier
+struct SwapBarrierMessage
+{
+    enum Type : uint32_t
+    {
+        FRAME_RECORDED = 1,
+        PRESENT = 2
+    };
+
+    static constexpr uint32_t MAGIC = 0x56534742; // "VSGB"
+
+    uint32_t magic = MAGIC;
+    uint32_t type = 0;
+    uint64_t frameCount = 0;
+    uint32_t clientID = 0;
+    uint32_t padding = 0;
+};
+
+struct SwapBarrier
+{
+    // master, the number of clients to wait for, the recordedReceiver listens for their FRAME_RECORDED messages and the presentBroadcaster sends the PRESENT messages.
+    uint32_t numClients = 0;
+    vsg::ref_ptr<Receiver> recordedReceiver;
+    vsg::ref_ptr<Broadcaster> presentBroadcaster;
+
+    // client, the recordedBroadcaster sends FRAME_RECORDED messages to the master and the presentReceiver listens for the PRESENT messages.
+    uint32_t clientID = 0;
+    vsg::ref_ptr<Broadcaster> recordedBroadcaster;
+    vsg::ref_ptr<Receiver> presentReceiver;
+
+    // maximum time, in seconds, to wait at the barrier each frame.
+    double timeout = 0.1;
+
+    // granularity, in seconds, of the socket timeout used when polling for messages.
+    static constexpr double pollInterval = 0.002;
+
+    // timing stats
+    uint64_t numFrames = 0;
+    uint64_t numTimeouts = 0;
+    double totalWaitTime = 0.0; // milliseconds
+    double maxWaitTime = 0.0;   // milliseconds
+
+    bool isMaster() const { return recordedReceiver.valid(); }
+
+    // call after recordAndSubmit() and before present() with the frameCount of the master's frame being rendered.
+    // Returns false if the wait timed out.
+    bool wait(uint64_t frameCount);
+
+    void report(std::ostream& out) const;
+
+protected:
+    bool waitForClients(uint64_t frameCount);
+    bool waitForPresent(uint64_t frameCount);
+};
@@ -0,0 +1,58 @@
+#include "TransportStats.h"
+
+void TransportStats::recordAssemblyLatency(double seconds)
+{
+    uint64_t microseconds = seconds > 0.0 ? static_cast<uint64_t>(seconds * 1e6) : 0;
+
+    std::size_t bucket = 0;
+    while (microseconds > 0 && bucket < NUM_LATENCY_BUCKETS - 1)
+    {
+        microseconds >>= 1;
+        ++bucket;
+    }
+
+    add(assemblyLatency[bucket], 1);
+}
+
+void TransportStats::reset()
+{
+    for (auto* counter : {&packetSetsSent, &packetsSent, &bytesSent, &packetsRetransmitted,
+                          &packetsReceived, &bytesReceived, &truncatedPackets, &malformedPackets, &latePackets, &packetSetsCompleted,
+                          &incompleteSetsDiscarded, &socketTimeouts, &nacksSent, &reliableSetsAbandoned,
+                          &poolHits, &poolMisses})
+    {
+        *counter = 0;
+    }
+
+    for (auto& counter : assemblyLatency) counter = 0;
+}
+
+void TransportStats::report(std::ostream& out) const
+{
+    if (packetSetsSent > 0)
+    {
+        out << "sent : sets = " << packetSetsSent << ", packets = " << packetsSent << ", bytes = " << bytesSent
+            << ", retransmitted = " << packetsRetransmitted << std::endl;
+    }
+
+    if (packetsReceived > 0 || packetSetsCompleted > 0 || socketTimeouts > 0)
+    {
+        out << "recieved : sets = " << packetSetsCompleted << ", packets = " << packetsReceived << ", bytes = " << bytesReceived
+            << ", truncated = " << truncatedPackets << ", malformed = " << malformedPackets << ", late = " << latePackets
+            << ", incomplete sets discarded = " << incompleteSetsDiscarded << ", socket timeouts = " << socketTimeouts
+            << ", nacks = " << nacksSent << ", reliable sets abandoned = " << reliableSetsAbandoned << std::endl;
+
+        out << "packet pool : hits = " << poolHits << ", misses = " << poolMisses << std::endl;
+
+        out << "assembly latency :";
+        for (std::size_t i = 0; i < NUM_LATENCY_BUCKETS; ++i)
+        {
+            uint64_t count = assemblyLatency[i];
+            if (count == 0) continue;
+
+            if (i + 1 < NUM_LATENCY_BUCKETS) out << " <" << (1ull << i) << "us:" << count;
+            else out << " >=" << (1ull << (i - 1)) << "us:" << count;
+        }
+        out << std::endl;
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <iostream>
+
+#include <vsg/core/Inherit.h>
+
+////////////////////////////////////////////////////////////
+// TransportStats.h
+//
+// Counters recorded by PacketBroadcaster and PacketReceiver. The counters are atomic so
+// they can be read, for instance from the frame loop, while the network thread updates them.
+//
+
+class TransportStats : public vsg::Inherit<vsg::Object, TransportStats>
+{
+public:
+    using Counter = std::atomic<uint64_t>;
+
+    // sending
+    Counter packetSetsSent{0};
+    Counter packetsSent{0};
+    Counter bytesSent{0};
+    Counter packetsRetransmitted{0};
+
+    // recieving
+    Counter packetsReceived{0};
+    Counter bytesReceived{0};
+    Counter truncatedPackets{0};
+    Counter malformedPackets{0};
+    Counter latePackets{0};
+    Counter packetSetsCompleted{0};
+    Counter incompleteSetsDiscarded{0};
+    Counter socketTimeouts{0};
+    Counter nacksSent{0};
+    Counter reliableSetsAbandoned{0};
+
+    // createPacket() served from a pool vs allocated
+    Counter poolHits{0};
+    Counter poolMisses{0};
+
+    // histogram of the time from the first packet of a PacketSet arriving to its completion,
+    // bucket i counts latencies in the range [2^(i-1), 2^i) microseconds, with the last bucket open ended.
+    static constexpr std::size_t NUM_LATENCY_BUCKETS = 24;
+    std::array<Counter, NUM_LATENCY_BUCKETS> assemblyLatency{};
+
+    void recordAssemblyLatency(double seconds);
+
+    // reset all counters to 0, not atomic with respect to concurrent updates.
+    void reset();
+
+    void report(std::ostream& out) const;
+
+    static void add(Counter& counter, uint64_t value) { counter.fetch_add(value, std::memory_order_relaxed); }
+};
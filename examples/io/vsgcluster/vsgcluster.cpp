@@ -5,10 +5,14 @@
 #endif
 
 #include <iostream>
+#include <thread>
 
 #include "Broadcaster.h"
 #include "Receiver.h"
 #include "Packet.h"
+#include "ReceiverThread.h"
+#include "SharedMemory.h"
+#include "SwapBarrier.h"
 
 namespace cluster
 {
@@ -16,11 +20,26 @@ namespace cluster
 class ViewerData : public vsg::Inherit<vsg::Object, ViewerData>
 {
 public:
+    // bit mask of the optional fields that are written, delta frames only contain the fields that differ from the keyframe
+    enum Fields : uint32_t
+    {
+        ALIVE = 1 << 0,
+        LOOKAT_EYE = 1 << 1,
+        LOOKAT_CENTER = 1 << 2,
+        LOOKAT_UP = 1 << 3,
+        ALL_FIELDS = ALIVE | LOOKAT_EYE | LOOKAT_CENTER | LOOKAT_UP
+    };
 
     bool alive = true;
     vsg::ref_ptr<vsg::FrameStamp> frameStamp;
     vsg::ref_ptr<vsg::LookAt> lookAt;
 
+    // frameCount of the keyframe this data was encoded against, equal to frameCount for keyframes
+    uint64_t keyframe = 0;
+    uint32_t fields = ALL_FIELDS;
+
+    bool isKeyframe() const { return fields == ALL_FIELDS && keyframe == frameStamp->frameCount; }
+
     void read(vsg::Input& input) override
     {
         vsg::Object::read(input);
@@ -28,26 +47,112 @@ public:
         if (!frameStamp) frameStamp = vsg::FrameStamp::create();
         if (!lookAt) lookAt = vsg::LookAt::create();
 
-        input.read("alive", alive);
+        input.read("keyframe", keyframe);
+        input.read("fields", fields);
         input.read("frameCount", frameStamp->frameCount);
-        input.read("lookAt.eye", lookAt->eye);
-        input.read("lookAt.center", lookAt->center);
-        input.read("lookAt.up", lookAt->up);
+        if (fields & ALIVE) input.read("alive", alive);
+        if (fields & LOOKAT_EYE) input.read("lookAt.eye", lookAt->eye);
+        if (fields & LOOKAT_CENTER) input.read("lookAt.center", lookAt->center);
+        if (fields & LOOKAT_UP) input.read("lookAt.up", lookAt->up);
     }
 
     void write(vsg::Output& output) const override
     {
         vsg::Object::write(output);
 
-        output.write("alive", alive);
+        output.write("keyframe", keyframe);
+        output.write("fields", fields);
         output.write("frameCount", frameStamp->frameCount);
-        output.write("lookAt.eye", lookAt->eye);
-        output.write("lookAt.center", lookAt->center);
-        output.write("lookAt.up", lookAt->up);
+        if (fields & ALIVE) output.write("alive", alive);
+        if (fields & LOOKAT_EYE) output.write("lookAt.eye", lookAt->eye);
+        if (fields & LOOKAT_CENTER) output.write("lookAt.center", lookAt->center);
+        if (fields & LOOKAT_UP) output.write("lookAt.up", lookAt->up);
     }
 };
 
-}
+// snapshot of the ViewerData values at a keyframe, used as the reference for encoding and decoding deltas
+struct ViewerDataKeyframe
+{
+    bool valid = false;
+    uint64_t frameCount = 0;
+    bool alive = true;
+    vsg::dvec3 eye;
+    vsg::dvec3 center;
+    vsg::dvec3 up;
+
+    void set(const ViewerData& viewerData)
+    {
+        valid = true;
+        frameCount = viewerData.frameStamp->frameCount;
+        alive = viewerData.alive;
+        eye = viewerData.lookAt->eye;
+        center = viewerData.lookAt->center;
+        up = viewerData.lookAt->up;
+    }
+};
+
+// Server side, assigns the keyframe and fields of a ViewerData so only the fields that differ from the last keyframe are broadcast.
+// Full keyframes are sent every keyframeInterval frames so that late joining clients, or ones that missed a keyframe, can resync.
+class ViewerDataEncoder
+{
+public:
+    uint64_t keyframeInterval = 60;
+
+    void encode(ViewerData& viewerData, bool forceKeyframe = false)
+    {
+        uint64_t frameCount = viewerData.frameStamp->frameCount;
+        if (forceKeyframe || !_keyframe.valid || (frameCount - _keyframe.frameCount) >= keyframeInterval)
+        {
+            _keyframe.set(viewerData);
+
+            viewerData.keyframe = frameCount;
+            viewerData.fields = ViewerData::ALL_FIELDS;
+            return;
+        }
+
+        uint32_t fields = 0;
+        if (viewerData.alive != _keyframe.alive) fields |= ViewerData::ALIVE;
+        if (viewerData.lookAt->eye != _keyframe.eye) fields |= ViewerData::LOOKAT_EYE;
+        if (viewerData.lookAt->center != _keyframe.center) fields |= ViewerData::LOOKAT_CENTER;
+        if (viewerData.lookAt->up != _keyframe.up) fields |= ViewerData::LOOKAT_UP;
+
+        viewerData.keyframe = _keyframe.frameCount;
+        viewerData.fields = fields;
+    }
+
+protected:
+    ViewerDataKeyframe _keyframe;
+};
+
+// Client side, fills in the fields omitted from a delta using the last keyframe recieved.
+class ViewerDataDecoder
+{
+public:
+    // returns false if the ViewerData is a delta against a keyframe that hasn't been recieved, in which case it should be ignored.
+    bool decode(ViewerData& viewerData)
+    {
+        if (viewerData.isKeyframe())
+        {
+            _keyframe.set(viewerData);
+            return true;
+        }
+
+        if (!_keyframe.valid || viewerData.keyframe != _keyframe.frameCount) return false;
+
+        if (!(viewerData.fields & ViewerData::ALIVE)) viewerData.alive = _keyframe.alive;
+        if (!(viewerData.fields & ViewerData::LOOKAT_EYE)) viewerData.lookAt->eye = _keyframe.eye;
+        if (!(viewerData.fields & ViewerData::LOOKAT_CENTER)) viewerData.lookAt->center = _keyframe.center;
+        if (!(viewerData.fields & ViewerData::LOOKAT_UP)) viewerData.lookAt->up = _keyframe.up;
+
+        viewerData.fields = ViewerData::ALL_FIELDS;
+        return true;
+    }
+
+protected:
+    ViewerDataKeyframe _keyframe;
+};
+
+}  // namespace cluster
 
 // Provide the means for the vsg::type_name<class> to get the human readable class name.
 EVSG_type_name(cluster::ViewerData);
@@ -91,6 +196,36 @@ int main(int argc, char** argv)
     auto portNumber = arguments.value<uint16_t>(9000, "--port");
     auto ifrName = arguments.value(std::string(), "--ifr-name");
     auto hostName = arguments.value(std::string(), "--host");
+    auto multicastGroup = arguments.value(std::string(), "--multicast");
+    auto multicastTTL = arguments.value<uint32_t>(1, "--ttl");
+    bool multicastLoopback = !arguments.read("--no-loopback");
+    auto keyframeInterval = arguments.value<uint64_t>(60, "--keyframe-interval");
+    auto parityGroupSize = arguments.value<uint32_t>(0, "--parity");
+    auto datagramSize = arguments.value<uint64_t>(0, "--packet-size");
+    auto codec = codecFromName(arguments.value(std::string("none"), "--codec"));
+    auto compressionLevel = arguments.value<int>(0, "--compression-level");
+    auto numReadThreads = arguments.value<std::size_t>(2, "--read-threads");
+
+    // report the transport stats at exit, and every statsInterval frames when non zero
+    bool reportStats = arguments.read("--stats");
+    auto statsInterval = arguments.value<uint64_t>(0, "--stats-interval");
+
+    // swap barrier settings, the server waits for --clients to report each frame recorded before all present together.
+    bool useSwapBarrier = arguments.read("--swap-barrier");
+    auto numClients = arguments.value<uint32_t>(1, "--clients");
+    auto clientID = arguments.value<uint32_t>(0, "--client-id");
+    auto barrierPortNumber = arguments.value<uint16_t>(portNumber + 1, "--barrier-port");
+    auto barrierTimeout = arguments.value(0.1, "--barrier-timeout");
+    auto masterHostName = arguments.value(std::string(), "--master");
+
+    // clients on the same host as the server can read the per frame data from shared memory rather than the network.
+    auto sharedMemoryName = arguments.value(std::string(), "--shm");
+
+    // reliable channel settings, with --upload the server sends the loaded scene graph to the clients rather than each loading it locally.
+    bool uploadScene = arguments.read("--upload");
+    auto nackPortNumber = arguments.value<uint16_t>(portNumber + 3, "--nack-port");
+    auto retransmitWindowSize = arguments.value<std::size_t>(4, "--retransmit-window");
+    auto reliableSendRate = arguments.value(50.0, "--send-rate"); // MB/s, 0 to disable pacing
 
     ViewerMode viewerMode = STAND_ALONE;
     if (arguments.read({"-s", "--serve"})) viewerMode = SERVER;
@@ -101,24 +236,79 @@ int main(int argc, char** argv)
         auto ifr_names = listNetworkConnections();
         for (auto& name : ifr_names)
         {
-            std::cout << name << std::endl;
+            std::cout << name << " mtu = " << getNetworkMTU(name) << std::endl;
         }
         return 0;
     }
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
+    // each datagram has to hold the packet header and at least one byte of data
+    if (datagramSize != 0 && datagramSize <= sizeof(Packet::Header))
+    {
+        std::cout << "--packet-size must be larger than the " << sizeof(Packet::Header) << " byte packet header." << std::endl;
+        return 1;
+    }
+
+    // every node of a cluster is started with the same --codec, so a node that can't decode it refuses to start rather than dropping every payload
+    if (!codecSupported(codec))
+    {
+        std::cout << "--codec " << codecName(codec) << " isn't supported by this build." << std::endl;
+        return 1;
+    }
+
+    // shared memory clients have no UDP receiver, so can't take part in the reliable transfers used to upload the scene
+    if (!sharedMemoryName.empty() && uploadScene)
+    {
+        std::cout << "--shm can't be combined with --upload, the scene is uploaded over the network." << std::endl;
+        return 1;
+    }
+
     std::cout << "portNumber = " << portNumber << std::endl;
     std::cout << "ifrName = " << ifrName << std::endl;
     std::cout << "hostName = " << hostName << std::endl;
     std::cout << "viewerMode = " << viewerMode << std::endl;
 
-    auto bc = Broadcaster::create_if(viewerMode == SERVER, portNumber, ifrName);
-    auto rc = Receiver::create_if(viewerMode == CLIENT, portNumber);
+    // in multicast mode the server sends to the group address, and clients join the group
+    if (!multicastGroup.empty()) hostName = multicastGroup;
+
+    auto bc = Broadcaster::create_if(viewerMode == SERVER, hostName, portNumber, ifrName);
+    auto rc = Receiver::create_if(viewerMode == CLIENT && sharedMemoryName.empty(), portNumber, multicastGroup, ifrName);
+
+    if (bc)
+    {
+        bc->setMulticastTTL(static_cast<unsigned char>(multicastTTL));
+        bc->setMulticastLoopback(multicastLoopback);
+    }
 
     std::cout << "bc = " << bc << std::endl;
     std::cout << "rc = " << rc << std::endl;
 
+    // clients report to the master on barrierPortNumber, the master sends present messages on barrierPortNumber + 1
+    std::unique_ptr<SwapBarrier> swapBarrier;
+    if (useSwapBarrier && viewerMode != STAND_ALONE)
+    {
+        swapBarrier.reset(new SwapBarrier);
+        swapBarrier->timeout = barrierTimeout;
+
+        if (viewerMode == SERVER)
+        {
+            swapBarrier->numClients = numClients;
+            swapBarrier->recordedReceiver = Receiver::create(barrierPortNumber);
+            swapBarrier->presentBroadcaster = Broadcaster::create(hostName, barrierPortNumber + 1, ifrName);
+            swapBarrier->presentBroadcaster->setMulticastTTL(static_cast<unsigned char>(multicastTTL));
+            swapBarrier->presentBroadcaster->setMulticastLoopback(multicastLoopback);
+        }
+        else
+        {
+            swapBarrier->clientID = clientID;
+            // without a master address the reports are broadcast on the local network
+            if (masterHostName.empty()) swapBarrier->recordedBroadcaster = Broadcaster::create(barrierPortNumber, ifrName);
+            else swapBarrier->recordedBroadcaster = Broadcaster::create(masterHostName, barrierPortNumber, ifrName);
+            swapBarrier->presentReceiver = Receiver::create(barrierPortNumber + 1, multicastGroup, ifrName);
+        }
+    }
+
     auto scene = vsg::Group::create();
     vsg::ref_ptr<vsg::EllipsoidModel> ellipsoidModel;
 
@@ -214,14 +404,66 @@ int main(int argc, char** argv)
 
     PacketBroadcaster broadcaster;
     broadcaster.broadcaster = bc;
+    broadcaster.datagramSize = datagramSize;
+    broadcaster.parityGroupSize = parityGroupSize;
+    broadcaster.codec = codec;
+    broadcaster.compressionLevel = compressionLevel;
+    broadcaster.retransmitWindowSize = retransmitWindowSize;
+    broadcaster.reliableSendRate = reliableSendRate * 1.0e6;
 
-    PacketReceiver receiver;
-    receiver.receiver = rc;
+    if (bc)
+    {
+        // clients send Nack to the server for packets of reliable transfers they have lost, polled each frame so it mustn't block
+        broadcaster.nackReceiver = Receiver::create(nackPortNumber);
+        broadcaster.nackReceiver->setTimeout(0.0);
+
+        if (uploadScene)
+        {
+            for (auto& child : scene->children) broadcaster.broadcastReliable(child);
+        }
+    }
+
+    std::unique_ptr<SharedMemoryBroadcaster> sharedMemoryBroadcaster;
+    std::unique_ptr<SharedMemoryReceiver> sharedMemoryReceiver;
+    if (!sharedMemoryName.empty())
+    {
+        if (viewerMode == SERVER)
+        {
+            sharedMemoryBroadcaster.reset(new SharedMemoryBroadcaster);
+            sharedMemoryBroadcaster->name = sharedMemoryName;
+        }
+        else if (viewerMode == CLIENT)
+        {
+            // polled from the frame loop so mustn't block
+            sharedMemoryReceiver.reset(new SharedMemoryReceiver);
+            sharedMemoryReceiver->name = sharedMemoryName;
+            sharedMemoryReceiver->timeout = 0.0;
+        }
+    }
+
+    // recieve on a dedicated network thread so the frame loop doesn't stall waiting on the socket
+    vsg::ref_ptr<ReceiverThread> receiverThread;
+    if (rc)
+    {
+        // deserialise on worker threads so large scene updates don't cause hitches in the frame loop
+        receiverThread = ReceiverThread::create(rc, 256, 16, numReadThreads);
+
+        // without a master address the Nack are broadcast on the local network
+        if (masterHostName.empty()) receiverThread->setNackBroadcaster(Broadcaster::create(nackPortNumber, ifrName));
+        else receiverThread->setNackBroadcaster(Broadcaster::create(masterHostName, nackPortNumber, ifrName));
+
+        receiverThread->start();
+    }
 
     auto viewerData = cluster::ViewerData::create();
     viewerData->frameStamp = viewer->getFrameStamp();
     viewerData->lookAt = lookAt;
 
+    cluster::ViewerDataEncoder viewerDataEncoder;
+    viewerDataEncoder.keyframeInterval = keyframeInterval;
+
+    cluster::ViewerDataDecoder viewerDataDecoder;
+
     // rendering main loop
     while (viewer->advanceToNextFrame() && (!viewerData || viewerData->alive))
     {
@@ -230,27 +472,70 @@ int main(int argc, char** argv)
             viewerData->frameStamp = viewer->getFrameStamp();
             viewerData->lookAt = lookAt;
 
+            viewerDataEncoder.encode(*viewerData);
+
             broadcaster.broadcast(viewer->getFrameStamp()->frameCount, viewerData);
+
+            broadcaster.processNacks();
+
+            if (sharedMemoryBroadcaster) sharedMemoryBroadcaster->broadcast(viewer->getFrameStamp()->frameCount, viewerData);
         }
 
-        if (rc)
+        if (receiverThread || sharedMemoryReceiver)
         {
-            //unsigned int size = rc->recieve(buffer.data(), buffer_size);
-            //std::cout << "recieved size = " << size << std::endl;
-            auto object = receiver.receive();
-            viewerData = object.cast<cluster::ViewerData>();
-            if (viewerData)
+            auto receiveObject = [&]() -> vsg::ref_ptr<vsg::Object> {
+                return receiverThread ? receiverThread->receive() : sharedMemoryReceiver->receive();
+            };
+
+            // drain everything recieved since the last frame, only the most recent ViewerData is applied
+            vsg::ref_ptr<cluster::ViewerData> receivedViewerData;
+            auto deadline = vsg::clock::now() + std::chrono::duration_cast<vsg::clock::duration>(std::chrono::duration<double>(barrierTimeout));
+            do
+            {
+                while (auto object = receiveObject())
+                {
+                    if (auto data = object.cast<cluster::ViewerData>())
+                    {
+                        if (viewerDataDecoder.decode(*data)) receivedViewerData = data;
+                    }
+                    else if (auto node = object.cast<vsg::Node>())
+                    {
+                        // scene graph uploaded by the server over the reliable channel, compile it before adding it to the scene
+                        vsg::CollectResourceRequirements collectRequirements;
+                        node->accept(collectRequirements);
+
+                        auto compileTraversal = vsg::CompileTraversal::create(viewer, collectRequirements.requirements);
+
+                        auto maxSets = collectRequirements.requirements.computeNumDescriptorSets();
+                        auto descriptorPoolSizes = collectRequirements.requirements.computeDescriptorPoolSizes();
+                        for (auto& context : compileTraversal->contexts)
+                        {
+                            if (descriptorPoolSizes.size() > 0) context->descriptorPool = vsg::DescriptorPool::create(context->device, maxSets, descriptorPoolSizes);
+                        }
+
+                        node->accept(*compileTraversal);
+                        compileTraversal->record();
+                        compileTraversal->waitForCompletion();
+
+                        scene->addChild(node);
+                    }
+                    else std::cout<<"recieved "<<object<<std::endl;
+                }
+
+                // when swap locked each frame must render the master's next frame, so wait for it to arrive
+                if (!swapBarrier || receivedViewerData) break;
+
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            } while (vsg::clock::now() < deadline);
+
+            if (receivedViewerData)
             {
-                std::cout<<"recieved viewerData "<<viewerData->alive<<std::endl;
+                viewerData = receivedViewerData;
 
                 lookAt->eye = viewerData->lookAt->eye;
                 lookAt->center = viewerData->lookAt->center;
                 lookAt->up = viewerData->lookAt->up;
             }
-            else
-            {
-                std::cout<<"recieved "<<object<<std::endl;
-            }
         }
 
         // pass any events into EventHandlers assigned to the Viewer
@@ -260,15 +545,41 @@ int main(int argc, char** argv)
 
         viewer->recordAndSubmit();
 
+        // hold presentation until every display on the wall has recorded the same frame
+        if (swapBarrier) swapBarrier->wait(viewerData->frameStamp->frameCount);
+
         viewer->present();
+
+        if (statsInterval > 0 && (viewer->getFrameStamp()->frameCount % statsInterval) == 0)
+        {
+            if (bc) broadcaster.stats->report(std::cout);
+            if (receiverThread) receiverThread->getStats()->report(std::cout);
+            if (sharedMemoryBroadcaster) sharedMemoryBroadcaster->stats->report(std::cout);
+            if (sharedMemoryReceiver) sharedMemoryReceiver->stats->report(std::cout);
+        }
     }
 
+    if (reportStats || statsInterval > 0)
+    {
+        if (bc) broadcaster.stats->report(std::cout);
+        if (receiverThread) receiverThread->getStats()->report(std::cout);
+        if (sharedMemoryBroadcaster) sharedMemoryBroadcaster->stats->report(std::cout);
+        if (sharedMemoryReceiver) sharedMemoryReceiver->stats->report(std::cout);
+    }
+
+    if (swapBarrier) swapBarrier->report(std::cout);
+
     if (bc)
     {
         viewerData->alive = false;
 
+        // send the shutdown as a keyframe so that it's applied even by clients that missed the last keyframe
+        viewerDataEncoder.encode(*viewerData, true);
+
         broadcaster.broadcast(viewer->getFrameStamp()->frameCount, viewerData);
 
+        if (sharedMemoryBroadcaster) sharedMemoryBroadcaster->broadcast(viewer->getFrameStamp()->frameCount, viewerData);
+
         // vsg::write(viewerData, "test.vsgt");
     }
 
@@ -0,0 +1,203 @@
+#include <vsg/all.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include "Broadcaster.h"
+#include "Packet.h"
+#include "Receiver.h"
+
+// Loopback benchmark of the vsgcluster transport, a PacketBroadcaster sends synthetic payloads to
+// multiple PacketReceiver running on separate threads in the same process so no external network is required.
+//
+// usage : vsgclusterbench --receivers 4 --size 5000000 --rate 60 --duration 10
+//         vsgclusterbench --multicast 239.0.0.1
+
+namespace cluster
+{
+
+class BenchmarkData : public vsg::Inherit<vsg::Object, BenchmarkData>
+{
+public:
+    uint64_t sequence = 0;
+    int64_t sendTime = 0; // steady_clock time since epoch in nanoseconds
+    vsg::ref_ptr<vsg::ubyteArray> payload;
+
+    void read(vsg::Input& input) override
+    {
+        vsg::Object::read(input);
+
+        input.read("sequence", sequence);
+        input.read("sendTime", sendTime);
+        input.read("payload", payload);
+    }
+
+    void write(vsg::Output& output) const override
+    {
+        vsg::Object::write(output);
+
+        output.write("sequence", sequence);
+        output.write("sendTime", sendTime);
+        output.write("payload", payload);
+    }
+};
+
+}
+
+EVSG_type_name(cluster::BenchmarkData);
+
+vsg::RegisterWithObjectFactoryProxy<cluster::BenchmarkData> s_Register_BenchmarkData;
+
+int64_t nanosecondsSinceEpoch()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct ReceiverStats
+{
+    uint64_t setsReceived = 0;
+    uint64_t bytesReceived = 0;
+    std::vector<double> latencies; // milliseconds
+};
+
+double percentile(std::vector<double>& values, double ratio)
+{
+    if (values.empty()) return 0.0;
+    std::size_t index = std::min(values.size() - 1, static_cast<std::size_t>(ratio * static_cast<double>(values.size())));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        vsg::CommandLine arguments(&argc, argv);
+        auto numReceivers = arguments.value<uint32_t>(2, "--receivers");
+        auto payloadSize = arguments.value<uint32_t>(1024 * 1024, "--size");
+        auto rate = arguments.value(60.0, "--rate");
+        auto duration = arguments.value(10.0, "--duration");
+        auto portNumber = arguments.value<uint16_t>(9100, "--port");
+        auto hostName = arguments.value(std::string("127.255.255.255"), "--host");
+        auto multicastGroup = arguments.value(std::string(), "--multicast");
+        auto ifrName = arguments.value(std::string("lo"), "--ifr-name");
+        auto parityGroupSize = arguments.value<uint32_t>(0, "--parity");
+        auto datagramSize = arguments.value<uint64_t>(0, "--packet-size");
+        auto codec = codecFromName(arguments.value(std::string("none"), "--codec"));
+
+        if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+        // each datagram has to hold the packet header and at least one byte of data
+        if (datagramSize != 0 && datagramSize <= sizeof(Packet::Header))
+        {
+            std::cout << "--packet-size must be larger than the " << sizeof(Packet::Header) << " byte packet header." << std::endl;
+            return 1;
+        }
+
+        // every node of a cluster is started with the same --codec, so a node that can't decode it refuses to start rather than dropping every payload
+        if (!codecSupported(codec))
+        {
+            std::cout << "--codec " << codecName(codec) << " isn't supported by this build." << std::endl;
+            return 1;
+        }
+
+        std::cout << "receivers = " << numReceivers << ", size = " << payloadSize << ", rate = " << rate << "Hz, duration = " << duration << "s, codec = " << codecName(codec) << ", parity = " << parityGroupSize << std::endl;
+
+        // set up the receivers, each on its own thread with its own socket bound to the same port.
+        std::atomic_bool receiving{true};
+        std::vector<ReceiverStats> receiverStats(numReceivers);
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < numReceivers; ++i)
+        {
+            threads.emplace_back([&, i]() {
+                PacketReceiver receiver;
+                receiver.receiver = Receiver::create(portNumber, multicastGroup, ifrName);
+
+                auto& stats = receiverStats[i];
+                while (receiving)
+                {
+                    auto data = receiver.receive().cast<cluster::BenchmarkData>();
+                    if (!data) continue;
+
+                    stats.latencies.push_back(static_cast<double>(nanosecondsSinceEpoch() - data->sendTime) * 1e-6);
+                    stats.setsReceived += 1;
+                    stats.bytesReceived += data->payload ? data->payload->dataSize() : 0;
+                }
+            });
+        }
+
+        // give the receivers time to bind their sockets before sending
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+        PacketBroadcaster broadcaster;
+        broadcaster.broadcaster = Broadcaster::create(multicastGroup.empty() ? hostName : multicastGroup, portNumber, ifrName);
+        broadcaster.datagramSize = datagramSize;
+        broadcaster.parityGroupSize = parityGroupSize;
+        broadcaster.codec = codec;
+
+        auto data = cluster::BenchmarkData::create();
+        data->payload = vsg::ubyteArray::create(payloadSize);
+
+        // fill with a mix of noise and repeated runs so compression has something realistic to work with
+        std::mt19937 random;
+        for (auto& value : *(data->payload)) value = (random() % 4 == 0) ? static_cast<uint8_t>(random()) : 0;
+
+        auto period = std::chrono::duration_cast<vsg::clock::duration>(std::chrono::duration<double>(1.0 / rate));
+        auto numSets = static_cast<uint64_t>(duration * rate);
+
+        uint64_t packetsSent = 0;
+        uint64_t bytesSent = 0;
+        double totalSendTime = 0.0;
+
+        auto startTime = vsg::clock::now();
+        for (uint64_t sequence = 0; sequence < numSets; ++sequence)
+        {
+            std::this_thread::sleep_until(startTime + period * sequence);
+
+            data->sequence = sequence;
+            data->sendTime = nanosecondsSinceEpoch();
+
+            auto startSend = vsg::clock::now();
+            broadcaster.broadcast(sequence, data);
+            totalSendTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - startSend).count();
+
+            packetsSent += broadcaster.packets.packets.size();
+            for (auto& packet : broadcaster.packets.packets) bytesSent += sizeof(Packet::Header) + packet.second->header.packetSize;
+        }
+        double sendDuration = std::chrono::duration<double>(vsg::clock::now() - startTime).count();
+
+        // allow in flight packets to arrive before stopping the receivers
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        receiving = false;
+        for (auto& thread : threads) thread.join();
+
+        std::cout << "\nsender : sets = " << numSets << ", packets = " << packetsSent
+                  << ", " << (static_cast<double>(bytesSent) / (1024.0 * 1024.0)) / sendDuration << " MB/s"
+                  << ", " << static_cast<double>(packetsSent) / sendDuration << " packets/s"
+                  << ", average broadcast() time = " << (numSets > 0 ? totalSendTime / static_cast<double>(numSets) : 0.0) << "ms" << std::endl;
+
+        for (uint32_t i = 0; i < numReceivers; ++i)
+        {
+            auto& stats = receiverStats[i];
+            double loss = numSets > 0 ? 100.0 * static_cast<double>(numSets - std::min(numSets, stats.setsReceived)) / static_cast<double>(numSets) : 0.0;
+
+            std::cout << "receiver " << i << " : sets = " << stats.setsReceived
+                      << ", loss = " << loss << "%"
+                      << ", " << (static_cast<double>(stats.bytesReceived) / (1024.0 * 1024.0)) / sendDuration << " MB/s payload"
+                      << ", latency p50 = " << percentile(stats.latencies, 0.5) << "ms"
+                      << ", p99 = " << percentile(stats.latencies, 0.99) << "ms" << std::endl;
+        }
+    }
+    catch (const vsg::Exception& ve)
+    {
+        for (int i = 0; i < argc; ++i) std::cerr << argv[i] << " ";
+        std::cerr << "\n[Exception] - " << ve.message << " result = " << ve.result << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
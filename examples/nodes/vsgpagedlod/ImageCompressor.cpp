@@ -0,0 +1,287 @@
+#include "ImageCompressor.h"
+
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    // 8 bit RGBA copy of a level of the mipmap chain
+    struct RGBAImage
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> pixels;
+    };
+
+    uint16_t packRGB565(int r, int g, int b)
+    {
+        return static_cast<uint16_t>((((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255));
+    }
+
+    void unpackRGB565(uint16_t color, int rgb[3])
+    {
+        int r = (color >> 11) & 31;
+        int g = (color >> 5) & 63;
+        int b = color & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    // encode the 4x4 block of RGBA texels starting at pixels, stride is the number of bytes per row of the image
+    void encodeBlock(const uint8_t* pixels, uint32_t stride, uint8_t* block)
+    {
+        int texels[16][3];
+        int minColor[3] = {255, 255, 255};
+        int maxColor[3] = {0, 0, 0};
+        int sum[3] = {0, 0, 0};
+        for (int i = 0; i < 16; ++i)
+        {
+            const uint8_t* texel = pixels + (i >> 2) * stride + (i & 3) * 4;
+            for (int c = 0; c < 3; ++c)
+            {
+                texels[i][c] = texel[c];
+                minColor[c] = std::min(minColor[c], texels[i][c]);
+                maxColor[c] = std::max(maxColor[c], texels[i][c]);
+                sum[c] += texels[i][c];
+            }
+        }
+
+        // use the diagonal of the colour bounding box that follows the distribution of the texels, green is used as the reference
+        int covarianceRG = 0;
+        int covarianceBG = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            int dg = texels[i][1] * 16 - sum[1];
+            covarianceRG += (texels[i][0] * 16 - sum[0]) * dg;
+            covarianceBG += (texels[i][2] * 16 - sum[2]) * dg;
+        }
+        if (covarianceRG < 0) std::swap(minColor[0], maxColor[0]);
+        if (covarianceBG < 0) std::swap(minColor[2], maxColor[2]);
+
+        // inset the end points slightly, reducing the error for the majority of texels lying inside the box
+        for (int c = 0; c < 3; ++c)
+        {
+            int inset = (maxColor[c] - minColor[c]) / 16;
+            maxColor[c] -= inset;
+            minColor[c] += inset;
+        }
+
+        uint16_t color0 = packRGB565(maxColor[0], maxColor[1], maxColor[2]);
+        uint16_t color1 = packRGB565(minColor[0], minColor[1], minColor[2]);
+
+        // color0 > color1 selects the 4 colour mode
+        if (color0 < color1) std::swap(color0, color1);
+
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            int palette[4][3];
+            unpackRGB565(color0, palette[0]);
+            unpackRGB565(color1, palette[1]);
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (int i = 0; i < 16; ++i)
+            {
+                uint32_t best = 0;
+                int bestDistance = INT_MAX;
+                for (uint32_t p = 0; p < 4; ++p)
+                {
+                    int dr = texels[i][0] - palette[p][0];
+                    int dg = texels[i][1] - palette[p][1];
+                    int db = texels[i][2] - palette[p][2];
+                    int distance = dr * dr + dg * dg + db * db;
+                    if (distance < bestDistance)
+                    {
+                        best = p;
+                        bestDistance = distance;
+                    }
+                }
+                indices |= best << (2 * i);
+            }
+        }
+
+        std::memcpy(block, &color0, 2);
+        std::memcpy(block + 2, &color1, 2);
+        std::memcpy(block + 4, &indices, 4);
+    }
+
+    // box filter the previous level down to the next level's dimensions
+    void downsample(const RGBAImage& source, RGBAImage& destination)
+    {
+        destination.pixels.resize(destination.width * destination.height * 4);
+        for (uint32_t y = 0; y < destination.height; ++y)
+        {
+            uint32_t sy0 = y * source.height / destination.height;
+            uint32_t sy1 = std::min(sy0 + 1, source.height - 1);
+            for (uint32_t x = 0; x < destination.width; ++x)
+            {
+                uint32_t sx0 = x * source.width / destination.width;
+                uint32_t sx1 = std::min(sx0 + 1, source.width - 1);
+                const uint8_t* p00 = &source.pixels[(sx0 + sy0 * source.width) * 4];
+                const uint8_t* p10 = &source.pixels[(sx1 + sy0 * source.width) * 4];
+                const uint8_t* p01 = &source.pixels[(sx0 + sy1 * source.width) * 4];
+                const uint8_t* p11 = &source.pixels[(sx1 + sy1 * source.width) * 4];
+                uint8_t* d = &destination.pixels[(x + y * destination.width) * 4];
+                for (int c = 0; c < 4; ++c)
+                {
+                    d[c] = static_cast<uint8_t>((p00[c] + p10[c] + p01[c] + p11[c] + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+struct ImageCompressor::EncodeOperation : public vsg::Inherit<vsg::Operation, ImageCompressor::EncodeOperation>
+{
+    EncodeOperation(const RGBAImage* in_image, uint32_t in_beginBlockRow, uint32_t in_endBlockRow, vsg::block64* in_blocks, vsg::ref_ptr<vsg::Latch> in_latch) :
+        image(in_image),
+        beginBlockRow(in_beginBlockRow),
+        endBlockRow(in_endBlockRow),
+        blocks(in_blocks),
+        latch(in_latch) {}
+
+    const RGBAImage* image;
+    uint32_t beginBlockRow;
+    uint32_t endBlockRow;
+    vsg::block64* blocks;
+    vsg::ref_ptr<vsg::Latch> latch;
+
+    void run() override
+    {
+        uint32_t stride = image->width * 4;
+        uint32_t numBlockColumns = image->width / 4;
+        for (uint32_t by = beginBlockRow; by < endBlockRow; ++by)
+        {
+            for (uint32_t bx = 0; bx < numBlockColumns; ++bx)
+            {
+                encodeBlock(&image->pixels[by * 4 * stride + bx * 16], stride, reinterpret_cast<uint8_t*>(&blocks[bx + by * numBlockColumns]));
+            }
+        }
+
+        if (latch) latch->count_down();
+    }
+};
+
+vsg::ref_ptr<vsg::Data> ImageCompressor::compress(vsg::ref_ptr<vsg::Data> image, vsg::ref_ptr<vsg::OperationThreads> operationThreads) const
+{
+    if (!image) return {};
+
+    auto& sourceLayout = image->getLayout();
+    bool srgb = false;
+    uint32_t numComponents = 0;
+    switch (sourceLayout.format)
+    {
+    case (VK_FORMAT_R8G8B8A8_SRGB): srgb = true; [[fallthrough]];
+    case (VK_FORMAT_R8G8B8A8_UNORM): numComponents = 4; break;
+    case (VK_FORMAT_R8G8B8_SRGB): srgb = true; [[fallthrough]];
+    case (VK_FORMAT_R8G8B8_UNORM): numComponents = 3; break;
+    default: return {};
+    }
+
+    uint32_t width = image->width();
+    uint32_t height = image->height();
+    if (image->valueSize() != numComponents || image->depth() != 1 || width == 0 || height == 0 || (width % 4) != 0 || (height % 4) != 0) return {};
+
+    auto start = vsg::clock::now();
+
+    // set up the chain of levels, each level's dimensions in blocks are halved down to a single block to match the vsg::Data mipmap layout
+    std::vector<RGBAImage> levels(1);
+    levels[0].width = width;
+    levels[0].height = height;
+    levels[0].pixels.resize(width * height * 4);
+
+    auto source = static_cast<const uint8_t*>(image->dataPointer());
+    if (numComponents == 4)
+    {
+        std::memcpy(levels[0].pixels.data(), source, levels[0].pixels.size());
+    }
+    else
+    {
+        for (uint32_t i = 0; i < width * height; ++i)
+        {
+            levels[0].pixels[i * 4 + 0] = source[i * 3 + 0];
+            levels[0].pixels[i * 4 + 1] = source[i * 3 + 1];
+            levels[0].pixels[i * 4 + 2] = source[i * 3 + 2];
+            levels[0].pixels[i * 4 + 3] = 255;
+        }
+    }
+
+    if (generateMipmaps)
+    {
+        while (levels.back().width > 4 || levels.back().height > 4)
+        {
+            RGBAImage next;
+            next.width = std::max(levels.back().width / 8, 1u) * 4;
+            next.height = std::max(levels.back().height / 8, 1u) * 4;
+            downsample(levels.back(), next);
+            levels.push_back(std::move(next));
+        }
+    }
+
+    std::size_t numBlocks = 0;
+    for (auto& level : levels) numBlocks += (level.width / 4) * (level.height / 4);
+
+    // vsg::Array2D takes ownership of the blocks, releasing them with vsg::deallocate()
+    auto blocks = static_cast<vsg::block64*>(vsg::allocate(sizeof(vsg::block64) * numBlocks, vsg::ALLOCATOR_AFFINITY_DATA));
+
+    // encode each level in bands of block rows, using the operationThreads to encode the bands in parallel
+    std::vector<vsg::ref_ptr<EncodeOperation>> operations;
+    std::size_t offset = 0;
+    uint32_t bandSize = std::max(blockRowsPerOperation, 1u);
+    for (auto& level : levels)
+    {
+        uint32_t numBlockRows = level.height / 4;
+        for (uint32_t row = 0; row < numBlockRows; row += bandSize)
+        {
+            operations.push_back(EncodeOperation::create(&level, row, std::min(row + bandSize, numBlockRows), blocks + offset, vsg::ref_ptr<vsg::Latch>()));
+        }
+        offset += (level.width / 4) * numBlockRows;
+    }
+
+    if (operationThreads && operations.size() > 1)
+    {
+        auto latch = vsg::Latch::create(static_cast<int>(operations.size()));
+        for (auto& operation : operations)
+        {
+            operation->latch = latch;
+            operationThreads->add(operation);
+        }
+
+        // encode on this thread as well, this also ensures progress when called from one of the operationThreads
+        operationThreads->run();
+        latch->wait();
+    }
+    else
+    {
+        for (auto& operation : operations) operation->run();
+    }
+
+    vsg::Data::Layout layout;
+    layout.format = srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    layout.blockWidth = 4;
+    layout.blockHeight = 4;
+    layout.maxNumMipmaps = static_cast<uint8_t>(levels.size());
+    layout.origin = sourceLayout.origin;
+
+    auto compressed = vsg::block64Array2D::create(width / 4, height / 4, blocks, layout);
+
+    ++numImagesCompressed;
+    numBytesIn += image->dataSize();
+    numBytesOut += sizeof(vsg::block64) * numBlocks;
+    totalTimeMicroseconds += static_cast<uint64_t>(std::chrono::duration<double, std::chrono::microseconds::period>(vsg::clock::now() - start).count());
+
+    return compressed;
+}
+
+void ImageCompressor::report(std::ostream& out) const
+{
+    out << "image compression : images = " << numImagesCompressed << ", bytes in = " << numBytesIn << ", bytes out = " << numBytesOut;
+    if (numImagesCompressed > 0) out << ", average time = " << (double(totalTimeMicroseconds) / double(numImagesCompressed) * 0.001) << "ms";
+    out << std::endl;
+}
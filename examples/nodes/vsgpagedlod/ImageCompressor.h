@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+
+////////////////////////////////////////////////////////////
+// ImageCompressor.h
+//
+// CPU side BC1 encoder applied to imagery tiles as they are loaded, so the tiles are uploaded and held
+// on the GPU at 4 bits per texel rather than 24 or 32. Compressed formats can't have their mipmaps
+// generated by the GPU with blits so the full mipmap chain is generated and compressed here too. The
+// blocks of each image are encoded in bands spread across the vsg::OperationThreads when provided.
+//
+
+class ImageCompressor : public vsg::Inherit<vsg::Object, ImageCompressor>
+{
+public:
+    // generate and compress mipmaps down to a single 4x4 block
+    bool generateMipmaps = true;
+
+    // number of rows of 4x4 blocks encoded by each operation
+    uint32_t blockRowsPerOperation = 16;
+
+    // return a BC1 compressed copy of image, or null if the image's format isn't supported.
+    // supported formats are 8 bit RGB and RGBA, UNORM or SRGB, with dimensions that are multiples of 4.
+    vsg::ref_ptr<vsg::Data> compress(vsg::ref_ptr<vsg::Data> image, vsg::ref_ptr<vsg::OperationThreads> operationThreads = {}) const;
+
+    // stats
+    mutable std::atomic<uint64_t> numImagesCompressed{0};
+    mutable std::atomic<uint64_t> numBytesIn{0};
+    mutable std::atomic<uint64_t> numBytesOut{0};
+    mutable std::atomic<uint64_t> totalTimeMicroseconds{0};
+
+    void report(std::ostream& out) const;
+
+    struct EncodeOperation;
+};
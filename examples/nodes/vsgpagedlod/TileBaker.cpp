@@ -0,0 +1,147 @@
+#include "TileBaker.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+struct TileBaker::BakeOperation : public vsg::Inherit<vsg::Operation, TileBaker::BakeOperation>
+{
+    BakeOperation(TileBaker* in_baker, const TileID& in_tile, vsg::ref_ptr<vsg::Latch> in_latch) :
+        baker(in_baker),
+        tile(in_tile),
+        latch(in_latch) {}
+
+    TileBaker* baker;
+    TileID tile;
+    vsg::ref_ptr<vsg::Latch> latch;
+
+    void run() override
+    {
+        baker->bakeTile(tile);
+        latch->count_down();
+    }
+};
+
+TileBaker::TileBaker(vsg::ref_ptr<TileReader> in_tileReader, vsg::ref_ptr<const vsg::Options> in_options, const vsg::Path& in_directory, uint32_t in_level) :
+    tileReader(in_tileReader),
+    options(in_options),
+    directory(in_directory),
+    level(in_level)
+{
+    operationThreads = vsg::OperationThreads::create(std::max(std::thread::hardware_concurrency(), 1u));
+}
+
+vsg::Path TileBaker::bakedFilename(const TileID& tile)
+{
+    return vsg::make_string("tiles/", tile.level, "/", tile.x, "_", tile.y, ".vsgb");
+}
+
+void TileBaker::rewriteFilenames(vsg::Group& group, std::vector<TileID>& tiles) const
+{
+    for (auto& child : group.children)
+    {
+        auto plod = child.cast<vsg::PagedLOD>();
+        if (!plod) continue;
+
+        // PagedLOD filenames are of the form "x y level.tile"
+        auto tile_info = plod->filename.substr(0, plod->filename.length() - 5);
+        std::basic_stringstream<vsg::Path::value_type> sstr(tile_info);
+
+        TileID tile;
+        sstr >> tile.x >> tile.y >> tile.level;
+
+        plod->filename = bakedFilename(tile);
+        tiles.push_back(tile);
+    }
+}
+
+bool TileBaker::bakeTile(const TileID& tile)
+{
+    auto subtiles = tileReader->read(vsg::make_string(tile.x, " ", tile.y, " ", tile.level, ".tile"), options).cast<vsg::Group>();
+    if (!subtiles)
+    {
+        ++numTilesFailed;
+        return false;
+    }
+
+    std::vector<TileID> children;
+    rewriteFilenames(*subtiles, children);
+
+    auto filename = directory + "/" + bakedFilename(tile);
+    if (!vsg::write(subtiles, filename))
+    {
+        std::cout << "Warning: unable to write " << filename << std::endl;
+        ++numTilesFailed;
+        return false;
+    }
+
+    ++numTilesBaked;
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _nextLevel.insert(_nextLevel.end(), children.begin(), children.end());
+
+    return true;
+}
+
+bool TileBaker::bake()
+{
+    if (tileReader->texturePool)
+    {
+        std::cout << "Warning: tiles using a texture pool can't be baked." << std::endl;
+        return false;
+    }
+
+    // the tiles at the TileReader's maxLevel are created without a PagedLOD, so limit maxLevel to the bake level while baking, restoring it however bake() returns
+    struct RestoreMaxLevel
+    {
+        TileReader& tileReader;
+        uint32_t maxLevel;
+        ~RestoreMaxLevel() { tileReader.maxLevel = maxLevel; }
+    } restoreMaxLevel{*tileReader, tileReader->maxLevel};
+    tileReader->maxLevel = std::min(restoreMaxLevel.maxLevel, std::max(level, 1u));
+
+    auto start = vsg::clock::now();
+
+    vsg::makeDirectory(directory);
+    vsg::makeDirectory(directory + "/tiles");
+
+    auto root = tileReader->read("root.tile", options).cast<vsg::Group>();
+    if (!root) return false;
+
+    std::vector<TileID> tiles;
+    rewriteFilenames(*root, tiles);
+
+    if (!vsg::write(root, directory + "/root.vsgb"))
+    {
+        std::cout << "Warning: unable to write " << directory << "/root.vsgb" << std::endl;
+        return false;
+    }
+
+    // bake a level at a time, the PagedLOD children of each level's tiles are the tiles to bake on the next level
+    while (!tiles.empty())
+    {
+        vsg::makeDirectory(vsg::make_string(directory, "/tiles/", tiles.front().level));
+
+        auto latch = vsg::Latch::create(static_cast<int>(tiles.size()));
+        for (auto& tile : tiles)
+        {
+            operationThreads->add(BakeOperation::create(this, tile, latch));
+        }
+        latch->wait();
+
+        std::cout << "Baked level " << tiles.front().level << ", " << tiles.size() << " tiles, " << numTilesFailed << " failed, "
+                  << std::chrono::duration<double>(vsg::clock::now() - start).count() << "s" << std::endl;
+
+        tiles.swap(_nextLevel);
+        _nextLevel.clear();
+        std::sort(tiles.begin(), tiles.end());
+    }
+
+    return numTilesFailed == 0;
+}
+
+void TileBaker::report(std::ostream& out) const
+{
+    out << "tile baker : directory = " << directory << ", level = " << level << ", tiles baked = " << numTilesBaked << ", failed = " << numTilesFailed << std::endl;
+}
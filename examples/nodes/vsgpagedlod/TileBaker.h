@@ -0,0 +1,53 @@
+#pragma once
+
+#include "TileReader.h"
+
+#include <mutex>
+
+////////////////////////////////////////////////////////////
+// TileBaker.h
+//
+// Offline generation of the tile pyramid that TileReader otherwise creates at runtime. Starting from
+// the root the quadtree is walked a level at a time down to the bake level, with the subtiles of each
+// tile read by TileReader in parallel on the operationThreads and written as a vsgb file per tile.
+// The PagedLOD filenames are rewritten to the baked files, relative to the bake directory, so the
+// baked root.vsgb can be paged from local disk without the TileReader or access to the tile server.
+//
+
+class TileBaker : public vsg::Inherit<vsg::Object, TileBaker>
+{
+public:
+    TileBaker(vsg::ref_ptr<TileReader> in_tileReader, vsg::ref_ptr<const vsg::Options> in_options, const vsg::Path& in_directory, uint32_t in_level);
+
+    vsg::ref_ptr<TileReader> tileReader;
+    vsg::ref_ptr<const vsg::Options> options;
+    vsg::Path directory;
+    uint32_t level;
+
+    // threads the tiles are baked on, defaults to one per core
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+
+    // bake the tiles down to level, returns false if any tile couldn't be baked
+    bool bake();
+
+    // filename of the baked subtiles of tile, relative to the directory
+    static vsg::Path bakedFilename(const TileID& tile);
+
+    // stats
+    std::atomic<uint64_t> numTilesBaked{0};
+    std::atomic<uint64_t> numTilesFailed{0};
+
+    void report(std::ostream& out) const;
+
+    struct BakeOperation;
+
+protected:
+    // replace the filenames of the group's PagedLOD children with their baked filenames, adding their tiles to tiles
+    void rewriteFilenames(vsg::Group& group, std::vector<TileID>& tiles) const;
+
+    // read and write the subtiles of tile, adding its children that need baking to the next level
+    bool bakeTile(const TileID& tile);
+
+    std::mutex _mutex;
+    std::vector<TileID> _nextLevel;
+};
@@ -0,0 +1,255 @@
+#include "TileCache.h"
+
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+TileCache::TileCache(const std::string& in_directory, uint64_t in_signature, uint32_t capacity) :
+    directory(in_directory),
+    signature(in_signature)
+{
+    options = vsg::Options::create();
+    options->extensionHint = "vsgb";
+
+    vsg::makeDirectory(directory);
+
+    if (!mapIndex(capacity)) return;
+
+    auto dataFilename = directory + "/tiles.data";
+    _dataFile.open(dataFilename, std::ios::in | std::ios::out | std::ios::binary);
+    if (!_dataFile.is_open())
+    {
+        // create the file then reopen it for reading and writing
+        std::ofstream(dataFilename, std::ios::binary);
+        _dataFile.open(dataFilename, std::ios::in | std::ios::out | std::ios::binary);
+    }
+
+    if (!_dataFile.is_open())
+    {
+        std::cerr << "TileCache unable to open " << dataFilename << std::endl;
+    }
+}
+
+TileCache::~TileCache()
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    if (_header)
+    {
+        std::ofstream fout(directory + "/tiles.index", std::ios::binary | std::ios::trunc);
+        fout.write(reinterpret_cast<const char*>(_indexBuffer.data()), _indexBuffer.size());
+    }
+#else
+    if (_index) munmap(_index, _indexSize);
+#endif
+}
+
+bool TileCache::mapIndex(uint32_t capacity)
+{
+    auto indexFilename = directory + "/tiles.index";
+
+    // the table size is kept as a power of two so the hash can be masked
+    uint32_t tableSize = 1;
+    while (tableSize < capacity) tableSize <<= 1;
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    std::ifstream fin(indexFilename, std::ios::binary | std::ios::ate);
+    if (fin.is_open() && fin.tellg() >= static_cast<std::streamoff>(sizeof(Header)))
+    {
+        _indexBuffer.resize(static_cast<std::size_t>(fin.tellg()));
+        fin.seekg(0);
+        fin.read(reinterpret_cast<char*>(_indexBuffer.data()), _indexBuffer.size());
+    }
+
+    auto existing = reinterpret_cast<Header*>(_indexBuffer.data());
+    if (_indexBuffer.size() < sizeof(Header) || existing->magic != MAGIC || _indexBuffer.size() != sizeof(Header) + existing->capacity * sizeof(Entry))
+    {
+        _indexBuffer.assign(sizeof(Header) + tableSize * sizeof(Entry), 0);
+    }
+    else if (existing->version != VERSION || existing->signature != signature)
+    {
+        std::cerr << "TileCache discarding " << directory << ", created with different TileReader settings" << std::endl;
+        _indexBuffer.assign(sizeof(Header) + tableSize * sizeof(Entry), 0);
+    }
+
+    _index = _indexBuffer.data();
+    _indexSize = _indexBuffer.size();
+#else
+    int fd = open(indexFilename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        perror("TileCache open");
+        return false;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) < 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    std::size_t size = static_cast<std::size_t>(sb.st_size);
+    if (size >= sizeof(Header))
+    {
+        Header existing;
+        if (pread(fd, &existing, sizeof(Header), 0) != sizeof(Header) || existing.magic != MAGIC || size != sizeof(Header) + existing.capacity * sizeof(Entry))
+        {
+            std::cerr << "TileCache discarding invalid index " << indexFilename << std::endl;
+            size = 0;
+        }
+        else if (existing.version != VERSION || existing.signature != signature)
+        {
+            std::cerr << "TileCache discarding " << directory << ", created with different TileReader settings" << std::endl;
+            size = 0;
+        }
+    }
+    else
+    {
+        size = 0;
+    }
+
+    if (size == 0)
+    {
+        // new, or invalid, index so start with an empty table
+        size = sizeof(Header) + tableSize * sizeof(Entry);
+        if (ftruncate(fd, 0) < 0 || ftruncate(fd, static_cast<off_t>(size)) < 0)
+        {
+            perror("TileCache ftruncate");
+            close(fd);
+            return false;
+        }
+    }
+
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (ptr == MAP_FAILED)
+    {
+        perror("TileCache mmap");
+        return false;
+    }
+
+    _index = ptr;
+    _indexSize = size;
+#endif
+
+    _header = static_cast<Header*>(_index);
+    _entries = reinterpret_cast<Entry*>(static_cast<uint8_t*>(_index) + sizeof(Header));
+
+    if (_header->magic != MAGIC)
+    {
+        _header->version = VERSION;
+        _header->signature = signature;
+        _header->capacity = tableSize;
+        _header->numEntries = 0;
+        _header->dataSize = 0;
+        _header->magic = MAGIC;
+    }
+
+    return true;
+}
+
+TileCache::Entry* TileCache::find(uint32_t x, uint32_t y, uint32_t level) const
+{
+    uint32_t mask = _header->capacity - 1;
+    uint32_t hash = (x * 73856093u) ^ (y * 19349663u) ^ (level * 83492791u);
+
+    for (uint32_t i = 0; i < _header->capacity; ++i)
+    {
+        auto& entry = _entries[(hash + i) & mask];
+        if (!entry.used || (entry.x == x && entry.y == y && entry.level == level)) return &entry;
+    }
+
+    return nullptr;
+}
+
+vsg::ref_ptr<vsg::Object> TileCache::read(uint32_t x, uint32_t y, uint32_t level) const
+{
+    if (!valid()) return {};
+
+    std::string buffer;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+
+        auto entry = find(x, y, level);
+        if (!entry || !entry->used)
+        {
+            ++numMisses;
+            return {};
+        }
+
+        buffer.resize(entry->size);
+        _dataFile.clear();
+        _dataFile.seekg(entry->offset);
+        _dataFile.read(buffer.data(), buffer.size());
+        if (!_dataFile)
+        {
+            ++numMisses;
+            return {};
+        }
+    }
+
+    // deserialize outside the lock so multiple threads can decode tiles at the same time
+    std::istringstream istr(buffer);
+    vsg::VSG rw;
+    auto tile = rw.read(istr, options);
+    if (tile) ++numHits;
+    else ++numMisses;
+
+    return tile;
+}
+
+bool TileCache::write(uint32_t x, uint32_t y, uint32_t level, vsg::ref_ptr<vsg::Object> tile)
+{
+    if (!valid() || !tile) return false;
+
+    // serialize outside the lock so multiple threads can encode tiles at the same time
+    std::ostringstream ostr;
+    vsg::VSG rw;
+    if (!rw.write(tile, ostr, options)) return false;
+
+    auto buffer = ostr.str();
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    // keep the table under 3/4 full so that probe sequences stay short
+    auto entry = find(x, y, level);
+    if (!entry || (!entry->used && (_header->numEntries + 1) * 4 > _header->capacity * 3)) return false;
+
+    // append the record then update the index, so an interrupted write leaves the index consistent
+    uint64_t offset = _header->dataSize;
+    _dataFile.clear();
+    _dataFile.seekp(offset);
+    _dataFile.write(buffer.data(), buffer.size());
+    _dataFile.flush();
+    if (!_dataFile) return false;
+
+    if (!entry->used) ++_header->numEntries;
+
+    entry->x = x;
+    entry->y = y;
+    entry->level = level;
+    entry->offset = offset;
+    entry->size = buffer.size();
+    entry->used = 1;
+
+    _header->dataSize = offset + buffer.size();
+
+    ++numWrites;
+
+    return true;
+}
+
+void TileCache::report(std::ostream& out) const
+{
+    out << "tile cache : " << directory;
+    if (_header) out << ", tiles = " << _header->numEntries << "/" << _header->capacity << ", data size = " << _header->dataSize;
+    out << ", hits = " << numHits << ", misses = " << numMisses << ", writes = " << numWrites << std::endl;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+
+////////////////////////////////////////////////////////////
+// TileCache.h
+//
+// Persistent local cache of the tiles created by TileReader, so that revisiting a region, or
+// re-expanding a PagedLOD after it's been expired, skips the image download, decode and geometry
+// generation. Each tile's decoded image and geometry subgraph are stored as a vsgb record appended
+// to a single tiles.data file, with a fixed size hash table in tiles.index, memory mapped where
+// supported, mapping the x/y/level of each tile to its record.
+//
+
+class TileCache : public vsg::Inherit<vsg::Object, TileCache>
+{
+public:
+    // open, or create, the cache in the specified directory for tiles created with settings matching signature.
+    // capacity is the maximum number of tiles a newly created cache can hold, an existing cache retains the capacity it was created with.
+    TileCache(const std::string& in_directory, uint64_t in_signature, uint32_t capacity = 65536);
+
+    bool valid() const { return _header != nullptr && _dataFile.is_open(); }
+
+    // return the tile from the cache, or null if it hasn't been cached.
+    vsg::ref_ptr<vsg::Object> read(uint32_t x, uint32_t y, uint32_t level) const;
+
+    // add a tile to the cache, returns false if the tile couldn't be added.
+    bool write(uint32_t x, uint32_t y, uint32_t level, vsg::ref_ptr<vsg::Object> tile);
+
+    vsg::ref_ptr<vsg::Options> options;
+
+    std::string directory;
+    uint64_t signature;
+
+    // stats
+    mutable std::atomic<uint64_t> numHits{0};
+    mutable std::atomic<uint64_t> numMisses{0};
+    std::atomic<uint64_t> numWrites{0};
+
+    void report(std::ostream& out) const;
+
+    static constexpr uint32_t MAGIC = 0x56534754; // "VSGT"
+    static constexpr uint32_t VERSION = 2;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t capacity;
+        uint32_t numEntries;
+        // size of the valid data in tiles.data, anything beyond it is from an interrupted write and is overwritten
+        uint64_t dataSize;
+        // signature of the TileReader settings the cached tiles were created with
+        uint64_t signature;
+        uint64_t padding[4];
+    };
+
+    struct Entry
+    {
+        uint32_t x;
+        uint32_t y;
+        uint32_t level;
+        uint32_t used;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+protected:
+    virtual ~TileCache();
+
+    bool mapIndex(uint32_t capacity);
+
+    // return the entry for x, y, level, or the unused entry where it should be inserted, or null if the table is full.
+    Entry* find(uint32_t x, uint32_t y, uint32_t level) const;
+
+    mutable std::mutex _mutex;
+    mutable std::fstream _dataFile;
+
+    void* _index = nullptr;
+    std::size_t _indexSize = 0;
+    Header* _header = nullptr;
+    Entry* _entries = nullptr;
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    // no memory mapping used on Windows, the index is held in memory and written back on destruction
+    std::vector<uint8_t> _indexBuffer;
+#endif
+};
@@ -0,0 +1,155 @@
+#include "TilePrefetcher.h"
+
+struct TilePrefetcher::PrefetchOperation : public vsg::Inherit<vsg::Operation, TilePrefetcher::PrefetchOperation>
+{
+    PrefetchOperation(const TileID& in_tile, vsg::observer_ptr<TilePrefetcher> in_prefetcher) :
+        tile(in_tile),
+        prefetcher(in_prefetcher) {}
+
+    TileID tile;
+    vsg::observer_ptr<TilePrefetcher> prefetcher;
+
+    void run() override
+    {
+        vsg::ref_ptr<TilePrefetcher> tilePrefetcher(prefetcher);
+        if (tilePrefetcher) tilePrefetcher->prefetch(tile);
+    }
+};
+
+TilePrefetcher::TilePrefetcher(vsg::ref_ptr<TileReader> in_tileReader, vsg::ref_ptr<vsg::LookAt> in_lookAt, vsg::ref_ptr<const vsg::Options> in_options) :
+    tileReader(in_tileReader),
+    lookAt(in_lookAt),
+    options(in_options),
+    _startTime(vsg::clock::now())
+{
+    // a single thread keeps prefetching from competing with the DatabasePager for the tile server and CPU
+    operationThreads = vsg::OperationThreads::create(1);
+}
+
+void TilePrefetcher::apply(vsg::FrameEvent& frame)
+{
+    double time = std::chrono::duration<double, std::chrono::seconds::period>(frame.time - _startTime).count();
+
+    _history.push_back(Sample{time, lookAt->eye});
+    while (_history.size() > std::max(numHistoryFrames, 2u)) _history.pop_front();
+
+    if (_history.size() < 2) return;
+
+    auto& first = _history.front();
+    auto& last = _history.back();
+    double duration = last.time - first.time;
+    if (duration <= 0.0) return;
+
+    // extrapolate the eye point assuming the velocity and frame rate seen over the history continue
+    vsg::dvec3 velocity = (last.eye - first.eye) / duration;
+    double frameTime = duration / double(_history.size() - 1);
+    vsg::dvec3 predictedEye = last.eye + velocity * (frameTime * double(numFramesAhead));
+
+    std::set<TileID> required;
+
+    // when the camera is effectively stationary the DatabasePager keeps up on its own
+    double altitude = std::max(tileReader->ellipsoidModel->convertECEFToLatLongAltitude(last.eye).z, 1.0);
+    if (vsg::length(predictedEye - last.eye) > altitude * 0.01)
+    {
+        computeRequiredTiles(predictedEye, required);
+    }
+
+    std::vector<TileID> toRequest;
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+
+        // changing the wanted set cancels any queued requests for tiles that are no longer required
+        _wanted.swap(required);
+
+        // forget completed tiles once they drop out of the prediction so they can be prefetched again on a later pass
+        for (auto itr = _completed.begin(); itr != _completed.end();)
+        {
+            if (_wanted.count(*itr) == 0) itr = _completed.erase(itr);
+            else ++itr;
+        }
+
+        for (auto& tile : _wanted)
+        {
+            if (_inFlight.count(tile) == 0 && _completed.count(tile) == 0)
+            {
+                _inFlight.insert(tile);
+                toRequest.push_back(tile);
+            }
+        }
+    }
+
+    for (auto& tile : toRequest)
+    {
+        ++numRequested;
+        operationThreads->add(PrefetchOperation::create(tile, vsg::observer_ptr<TilePrefetcher>(this)));
+    }
+}
+
+void TilePrefetcher::computeRequiredTiles(const vsg::dvec3& eye, std::set<TileID>& tiles) const
+{
+    auto lla = tileReader->ellipsoidModel->convertECEFToLatLongAltitude(eye);
+    double latitude = lla.x;
+    double longitude = lla.y;
+    double altitude = std::max(lla.z, 1.0);
+
+    // a PagedLOD loads its subtiles once the tile's bound fills lodTransitionScreenHeightRatio of the screen height,
+    // so find the deepest level where a tile beneath the eye point is large enough to pass that test.
+    double levelZeroTileSize = vsg::radians((tileReader->extents.max.x - tileReader->extents.min.x) / double(tileReader->noX)) * tileReader->ellipsoidModel->radiusEquator() * std::max(cos(vsg::radians(latitude)), 0.01);
+    double expandSize = tileReader->lodTransitionScreenHeightRatio * 2.0 * tan(vsg::radians(fieldOfViewY * 0.5)) * altitude;
+    if (levelZeroTileSize < expandSize) return;
+
+    uint32_t maxSubtileLevel = tileReader->maxLevel > 0 ? tileReader->maxLevel - 1 : 0;
+    uint32_t level = std::min(static_cast<uint32_t>(std::log2(levelZeroTileSize / expandSize)), maxSubtileLevel);
+
+    // the predicted tile and its neighbours, as the view will cover more than the tile directly beneath the eye
+    uint32_t x, y;
+    if (!tileReader->computeTile(latitude, longitude, level, x, y)) return;
+
+    for (int dy = -1; dy <= 1; ++dy)
+    {
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            if ((dx < 0 && x == 0) || (dy < 0 && y == 0)) continue;
+
+            uint32_t nx = x + dx;
+            uint32_t ny = y + dy;
+            if (nx >= (tileReader->noX << level) || ny >= (tileReader->noY << level)) continue;
+
+            tiles.insert(TileID{nx, ny, level});
+        }
+    }
+
+    // the parent tiles the DatabasePager will need to descend through to reach the predicted level
+    for (uint32_t i = 1; i <= numParentLevels && i <= level; ++i)
+    {
+        tiles.insert(TileID{x >> i, y >> i, level - i});
+    }
+}
+
+bool TilePrefetcher::prefetch(const TileID& tile)
+{
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        if (_wanted.count(tile) == 0)
+        {
+            _inFlight.erase(tile);
+            ++numCancelled;
+            return false;
+        }
+    }
+
+    tileReader->prefetch(tile, options);
+    ++numCompleted;
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _inFlight.erase(tile);
+    _completed.insert(tile);
+
+    return true;
+}
+
+void TilePrefetcher::report(std::ostream& out) const
+{
+    out << "prefetch : requested = " << numRequested << ", completed = " << numCompleted << ", cancelled = " << numCancelled
+        << ", used = " << tileReader->numPrefetchedTilesUsed << ", discarded = " << tileReader->numPrefetchedTilesDiscarded << std::endl;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "TileReader.h"
+
+#include <deque>
+#include <set>
+
+////////////////////////////////////////////////////////////
+// TilePrefetcher.h
+//
+// The DatabasePager only requests tiles once culling selects them, so fast camera motion outruns it.
+// TilePrefetcher tracks the LookAt eye point each frame, extrapolates where it will be numFramesAhead
+// frames from now, and reads the tiles that will be needed there on its own low priority thread. The
+// results are held by the TileReader until the DatabasePager asks for them. Requests that are still
+// queued when the prediction moves on are cancelled.
+//
+
+class TilePrefetcher : public vsg::Inherit<vsg::Visitor, TilePrefetcher>
+{
+public:
+    TilePrefetcher(vsg::ref_ptr<TileReader> in_tileReader, vsg::ref_ptr<vsg::LookAt> in_lookAt, vsg::ref_ptr<const vsg::Options> in_options);
+
+    vsg::ref_ptr<TileReader> tileReader;
+    vsg::ref_ptr<vsg::LookAt> lookAt;
+    vsg::ref_ptr<const vsg::Options> options;
+
+    // how far ahead to predict the eye point
+    uint32_t numFramesAhead = 30;
+
+    // number of frames of eye point history used to estimate the velocity
+    uint32_t numHistoryFrames = 8;
+
+    // number of levels above the predicted level to also prefetch, so the PagedLOD hierarchy leading down to it is available
+    uint32_t numParentLevels = 2;
+
+    // vertical field of view of the camera, used to estimate the level the PagedLOD will select
+    double fieldOfViewY = 30.0;
+
+    vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+
+    // stats
+    std::atomic<uint64_t> numRequested{0};
+    std::atomic<uint64_t> numCompleted{0};
+    std::atomic<uint64_t> numCancelled{0};
+
+    void apply(vsg::FrameEvent& frame) override;
+
+    void report(std::ostream& out) const;
+
+    struct PrefetchOperation;
+
+protected:
+    // compute the tiles whose subtiles will be needed with the eye at the specified ECEF position
+    void computeRequiredTiles(const vsg::dvec3& eye, std::set<TileID>& tiles) const;
+
+    // run by the PrefetchOperation, returns false if the tile is no longer wanted
+    bool prefetch(const TileID& tile);
+
+    struct Sample
+    {
+        double time;
+        vsg::dvec3 eye;
+    };
+
+    std::deque<Sample> _history;
+    vsg::clock::time_point _startTime;
+
+    std::mutex _mutex;
+    std::set<TileID> _wanted;
+    std::set<TileID> _inFlight;
+    std::set<TileID> _completed;
+};
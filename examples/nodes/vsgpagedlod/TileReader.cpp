@@ -1,5 +1,7 @@
 #include "TileReader.h"
 
+#include <sstream>
+
 vsg::dvec3 TileReader::computeLatitudeLongitudeAltitude(const vsg::dvec3& src) const
 {
     if (projection == "EPSG:3857" || projection == "spherical-mercator")
@@ -71,49 +73,177 @@ vsg::ref_ptr<vsg::Object> TileReader::read(const vsg::Path& filename, vsg::ref_p
 
         // std::cout<<"read("<<filename<<") -> tile_info = "<<tile_info<<", x = "<<x<<", y = "<<y<<", z = "<<lod<<std::endl;
 
-        return read_subtile(x, y, lod, options);
+        if (auto subtiles = takePrefetched(TileID{x, y, lod})) return subtiles;
+
+        auto start = vsg::clock::now();
+
+        vsg::ref_ptr<vsg::Object> subtiles;
+        if (!tileScheduler)
+        {
+            subtiles = read_subtile(x, y, lod, options);
+        }
+        else
+        {
+            bool granted = tileScheduler->acquire(computeTileBound(x, y, lod));
+            stats->addStage(TileStats::SCHEDULE, start);
+
+            if (granted)
+            {
+                subtiles = read_subtile(x, y, lod, options);
+                tileScheduler->release();
+            }
+        }
+
+        stats->addRequest(start, subtiles.valid());
+
+        return subtiles;
+    }
+}
+
+vsg::dsphere TileReader::computeTileBound(uint32_t x, uint32_t y, uint32_t level) const
+{
+    auto tile_extents = computeTileExtents(x, y, level);
+    auto toECEF = [&](double tx, double ty) { return ellipsoidModel->convertLatLongAltitudeToECEF(computeLatitudeLongitudeAltitude(vsg::dvec3(tx, ty, 0.0))); };
+
+    vsg::dvec3 center = toECEF((tile_extents.min.x + tile_extents.max.x) * 0.5, (tile_extents.min.y + tile_extents.max.y) * 0.5);
+
+    double radius = 0.0;
+    for (auto& corner : {toECEF(tile_extents.min.x, tile_extents.min.y), toECEF(tile_extents.max.x, tile_extents.min.y),
+                         toECEF(tile_extents.min.x, tile_extents.max.y), toECEF(tile_extents.max.x, tile_extents.max.y)})
+    {
+        radius = std::max(radius, vsg::length(corner - center));
+    }
+
+    return vsg::dsphere(center, radius);
+}
+
+uint64_t TileReader::computeCacheSignature() const
+{
+    std::ostringstream settings;
+    settings.precision(17);
+    settings << extents.min.x << " " << extents.min.y << " " << extents.max.x << " " << extents.max.y << " " << noX << " " << noY << " " << originTopLeft << " " << projection;
+    settings << " " << ellipsoidModel->radiusEquator() << " " << ellipsoidModel->radiusPolar();
+    settings << " " << imageLayer << " " << terrainLayer << " " << numRows << " " << numCols;
+
+    // skirts are only added to tiles with terrain
+    if (!terrainLayer.empty()) settings << " skirt " << skirtRatio;
+    if (imageCompressor) settings << " compress " << imageCompressor->generateMipmaps;
+
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (auto c : settings.str())
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool TileReader::computeTile(double latitude, double longitude, uint32_t level, uint32_t& x, uint32_t& y) const
+{
+    // inverse of the mapping applied by computeLatitudeLongitudeAltitude()
+    double src_y = latitude;
+    if (projection == "EPSG:3857" || projection == "spherical-mercator")
+    {
+        src_y = vsg::degrees(0.5 * asinh(tan(vsg::radians(latitude))));
+    }
+
+    double multiplier = pow(0.5, double(level));
+    double tileWidth = multiplier * (extents.max.x - extents.min.x) / double(noX);
+    double tileHeight = multiplier * (extents.max.y - extents.min.y) / double(noY);
+
+    double tx = (longitude - extents.min.x) / tileWidth;
+    double ty = originTopLeft ? (extents.max.y - src_y) / tileHeight : (src_y - extents.min.y) / tileHeight;
+
+    double numX = double(noX) / multiplier;
+    double numY = double(noY) / multiplier;
+    if (tx < 0.0 || tx >= numX || ty < 0.0 || ty >= numY) return false;
+
+    x = static_cast<uint32_t>(tx);
+    y = static_cast<uint32_t>(ty);
+    return true;
+}
+
+bool TileReader::prefetch(const TileID& tile, vsg::ref_ptr<const vsg::Options> options) const
+{
+    auto subtiles = read_subtile(tile.x, tile.y, tile.level, options);
+    if (!subtiles) return false;
+
+    std::scoped_lock<std::mutex> lock(prefetchMutex);
+
+    if (prefetchedTiles.count(tile) == 0) prefetchOrder.push_back(tile);
+    prefetchedTiles[tile] = subtiles;
+
+    while (prefetchedTiles.size() > maxPrefetchedTiles)
+    {
+        prefetchedTiles.erase(prefetchOrder.front());
+        prefetchOrder.pop_front();
+        ++numPrefetchedTilesDiscarded;
     }
+
+    return true;
+}
+
+vsg::ref_ptr<vsg::Object> TileReader::takePrefetched(const TileID& tile) const
+{
+    std::scoped_lock<std::mutex> lock(prefetchMutex);
+
+    auto itr = prefetchedTiles.find(tile);
+    if (itr == prefetchedTiles.end()) return {};
+
+    auto subtiles = itr->second;
+    prefetchedTiles.erase(itr);
+    prefetchOrder.remove(tile);
+
+    ++numPrefetchedTilesUsed;
+
+    return subtiles;
 }
 
 vsg::ref_ptr<vsg::Object> TileReader::read_root(vsg::ref_ptr<const vsg::Options> options) const
 {
-    auto group = createRoot();
+    auto group = createRoot(options);
+    if (!group) return {};
 
     uint32_t lod = 0;
     for (uint32_t y = 0; y < noY; ++y)
     {
         for (uint32_t x = 0; x < noX; ++x)
         {
-            auto imagePath = getTilePath(imageLayer, x, y, lod);
-            //auto terrainPath = getTilePath(terrainLayer, x, y, lod);
-
-            auto imageTile = vsg::read_cast<vsg::Data>(imagePath, options);
-            //auto terrainTile = vsg::read(terrainPath, options);
-
-            if (imageTile)
+            auto tile = readTile(x, y, lod, options);
+            if (tile)
             {
-                auto tile_extents = computeTileExtents(x, y, lod);
-                auto tile = createTile(tile_extents, imageTile);
-                if (tile)
-                {
-                    vsg::ComputeBounds computeBound;
-                    tile->accept(computeBound);
-                    auto& bb = computeBound.bounds;
-                    vsg::dsphere bound((bb.min.x + bb.max.x) * 0.5, (bb.min.y + bb.max.y) * 0.5, (bb.min.z + bb.max.z) * 0.5, vsg::length(bb.max - bb.min) * 0.5);
-
-                    auto plod = vsg::PagedLOD::create();
-                    plod->bound = bound;
-                    plod->children[0] = vsg::PagedLOD::Child{0.25, {}};  // external child visible when it's bound occupies more than 1/4 of the height of the window
-                    plod->children[1] = vsg::PagedLOD::Child{0.0, tile}; // visible always
-                    plod->filename = vsg::make_string(x, " ", y, " 0.tile");
-                    plod->options = options;
-
-                    group->addChild(plod);
-                }
+                vsg::ComputeBounds computeBound;
+                tile->accept(computeBound);
+                auto& bb = computeBound.bounds;
+                vsg::dsphere bound((bb.min.x + bb.max.x) * 0.5, (bb.min.y + bb.max.y) * 0.5, (bb.min.z + bb.max.z) * 0.5, vsg::length(bb.max - bb.min) * 0.5);
+
+                auto plod = vsg::PagedLOD::create();
+                plod->bound = bound;
+                plod->children[0] = vsg::PagedLOD::Child{0.25, {}};  // external child visible when it's bound occupies more than 1/4 of the height of the window
+                plod->children[1] = vsg::PagedLOD::Child{0.0, tile}; // visible always
+                plod->filename = vsg::make_string(x, " ", y, " 0.tile");
+                plod->options = options;
+
+                group->addChild(plod);
             }
         }
     }
 
+    if (texturePool)
+    {
+        // all tiles select their texture from the pool's textures bound here, so there is just the one descriptor set for the whole database
+        auto descriptorImage = texturePool->createDescriptorImage(0);
+        if (!descriptorImage)
+        {
+            std::cout << "Warning: unable to set up the tile texture pool." << std::endl;
+            return {};
+        }
+
+        auto descriptorSet = vsg::DescriptorSet::create(descriptorSetLayout, vsg::Descriptors{descriptorImage});
+        group->add(vsg::BindDescriptorSets::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, vsg::DescriptorSets{descriptorSet}));
+    }
+
     uint32_t estimatedNumOfTilesBelow = 0;
     uint32_t maxNumTilesBelow = 40000;
 
@@ -123,7 +253,8 @@ vsg::ref_ptr<vsg::Object> TileReader::read_root(vsg::ref_ptr<const vsg::Options>
         estimatedNumOfTilesBelow += std::pow(4, i - level);
     }
 
-    uint32_t tileMultiplier = std::min(estimatedNumOfTilesBelow, maxNumTilesBelow) + 1;
+    // the texture pool's descriptor set is the only one in the database, so doesn't need scaling up for the tiles below
+    uint32_t tileMultiplier = texturePool ? 1 : std::min(estimatedNumOfTilesBelow, maxNumTilesBelow) + 1;
 
     // set up the ResourceHints required to make sure the VSG preallocates enough Vulkan resources for the paged database
     vsg::CollectResourceRequirements collectRequirements;
@@ -136,93 +267,169 @@ vsg::ref_ptr<vsg::Object> TileReader::read_root(vsg::ref_ptr<const vsg::Options>
     return group;
 }
 
-vsg::ref_ptr<vsg::Object> TileReader::read_subtile(uint32_t x, uint32_t y, uint32_t lod, vsg::ref_ptr<const vsg::Options> options) const
+bool TileReader::readTileData(uint32_t x, uint32_t y, uint32_t lod, vsg::ref_ptr<const vsg::Options> options, vsg::ref_ptr<vsg::Data>& imageTile, vsg::ref_ptr<vsg::Data>& terrainTile) const
 {
-    // std::cout<<"Need to load subtile for "<<x<<", "<<y<<", "<<lod<<std::endl;
+    auto start = vsg::clock::now();
 
-    // need to load subtile x y lod
+    auto imagePath = getTilePath(imageLayer, x, y, lod);
+    if (terrainLayer.empty())
+    {
+        imageTile = vsg::read_cast<vsg::Data>(imagePath, options);
+    }
+    else
+    {
+        // vsg::read() reads the image and terrain in parallel when options->operationThreads are available
+        auto terrainPath = getTilePath(terrainLayer, x, y, lod);
+        auto pathObjects = vsg::read(vsg::Paths{imagePath, terrainPath}, options);
+        imageTile = pathObjects[imagePath].cast<vsg::Data>();
+        terrainTile = pathObjects[terrainPath].cast<vsg::Data>();
+    }
 
-    vsg::time_point start_read = vsg::clock::now();
+    start = stats->addStage(TileStats::READ, start);
 
-    auto group = vsg::Group::create();
+    // vsgXchange only returns the decoded data so the bytes read are counted after decoding
+    if (imageTile) stats->addBytesRead(imageTile->dataSize());
+    if (terrainTile) stats->addBytesRead(terrainTile->dataSize());
 
-    struct TileID
+    if (imageTile && imageCompressor)
     {
-        uint32_t local_x;
-        uint32_t local_y;
-    };
+        if (auto compressed = imageCompressor->compress(imageTile, options ? options->operationThreads : vsg::ref_ptr<vsg::OperationThreads>())) imageTile = compressed;
+        stats->addStage(TileStats::COMPRESS, start);
+    }
+
+    return imageTile.valid();
+}
+
+vsg::ref_ptr<vsg::Node> TileReader::readTile(uint32_t x, uint32_t y, uint32_t lod, vsg::ref_ptr<const vsg::Options> options) const
+{
+    vsg::ref_ptr<vsg::Data> imageTile;
+    vsg::ref_ptr<vsg::Data> terrainTile;
+
+    if (!tileCache)
+    {
+        if (!readTileData(x, y, lod, options, imageTile, terrainTile)) return {};
+
+        auto start = vsg::clock::now();
+        auto tile = createTile(computeTileExtents(x, y, lod), imageTile, terrainTile);
+        stats->addStage(TileStats::GEOMETRY, start);
 
-    vsg::Paths tiles;
-    std::map<vsg::Path, TileID> pathToTileID;
+        return tile;
+    }
+
+    // the cache holds the image and geometry, the texture state is recreated so that the sampler and layouts remain shared between tiles
+    auto start = vsg::clock::now();
+    auto cached = tileCache->read(x, y, lod).cast<vsg::Objects>();
+    start = stats->addStage(TileStats::CACHE, start);
+
+    if (cached && cached->children.size() == 2)
+    {
+        auto cachedImage = cached->children[0].cast<vsg::Data>();
+        auto geometry = cached->children[1].cast<vsg::Node>();
+        if (cachedImage && geometry)
+        {
+            auto tile = createTextureState(cachedImage, geometry);
+            stats->addStage(TileStats::GEOMETRY, start);
+            return tile;
+        }
+    }
+
+    if (!readTileData(x, y, lod, options, imageTile, terrainTile)) return {};
+
+    start = vsg::clock::now();
+    auto geometry = createECEFGeometry(computeTileExtents(x, y, lod), imageTile, terrainTile);
+    stats->addStage(TileStats::GEOMETRY, start);
+
+    auto record = vsg::Objects::create();
+    record->addChild(imageTile);
+    record->addChild(geometry);
+    tileCache->write(x, y, lod, record);
+
+    start = vsg::clock::now();
+    auto tile = createTextureState(imageTile, geometry);
+    stats->addStage(TileStats::GEOMETRY, start);
+
+    return tile;
+}
+
+struct TileReader::ReadSubtileOperation : public vsg::Inherit<vsg::Operation, TileReader::ReadSubtileOperation>
+{
+    ReadSubtileOperation(const TileReader* in_tileReader, uint32_t in_x, uint32_t in_y, uint32_t in_lod, vsg::ref_ptr<const vsg::Options> in_options, vsg::ref_ptr<vsg::Latch> in_latch) :
+        tileReader(in_tileReader),
+        x(in_x),
+        y(in_y),
+        lod(in_lod),
+        options(in_options),
+        latch(in_latch) {}
+
+    const TileReader* tileReader;
+    uint32_t x;
+    uint32_t y;
+    uint32_t lod;
+    vsg::ref_ptr<const vsg::Options> options;
+    vsg::ref_ptr<vsg::Latch> latch;
+    vsg::time_point queued = vsg::clock::now();
+
+    vsg::ref_ptr<vsg::Node> subtile;
+
+    void run() override
+    {
+        auto start = tileReader->stats->addStage(TileStats::QUEUE, queued);
+
+        auto tile = tileReader->readTile(x, y, lod, options);
+        if (tile)
+        {
+            subtile = tileReader->createSubtile(x, y, lod, tile, options);
+            tileReader->stats->addTile(lod, start);
+        }
+
+        latch->count_down();
+    }
+};
+
+vsg::ref_ptr<vsg::Object> TileReader::read_subtile(uint32_t x, uint32_t y, uint32_t lod, vsg::ref_ptr<const vsg::Options> options) const
+{
+    // std::cout<<"Need to load subtile for "<<x<<", "<<y<<", "<<lod<<std::endl;
+
+    // need to load subtile x y lod
+
+    auto group = vsg::Group::create();
 
     uint32_t subtile_x = x * 2;
     uint32_t subtile_y = y * 2;
     uint32_t local_lod = lod + 1;
+
+    // each subtile's image read and tile creation is independent of the others so they are run as separate operations.
+    auto latch = vsg::Latch::create(4);
+    std::vector<vsg::ref_ptr<ReadSubtileOperation>> operations;
     for (uint32_t dy = 0; dy < 2; ++dy)
     {
         for (uint32_t dx = 0; dx < 2; ++dx)
         {
-            uint32_t local_x = subtile_x + dx;
-            uint32_t local_y = subtile_y + dy;
-            auto tilePath = getTilePath(imageLayer, local_x, local_y, local_lod);
-            tiles.push_back(tilePath);
-            pathToTileID[tilePath] = TileID{local_x, local_y};
+            operations.push_back(ReadSubtileOperation::create(this, subtile_x + dx, subtile_y + dy, local_lod, options, latch));
         }
     }
 
-    auto pathObjects = vsg::read(tiles, options);
-
-    if (pathObjects.size() == 4)
+    if (options && options->operationThreads)
     {
-        for (auto& [tilePath, object] : pathObjects)
+        // the calling thread handles the first subtile itself rather than sitting idle while the operation threads handle the rest,
+        // the rest are queued at the front and run on this thread as well so progress is ensured when called from one of the operationThreads
+        for (std::size_t i = 1; i < operations.size(); ++i)
         {
-            auto& tileID = pathToTileID[tilePath];
-            auto imageTile = object.cast<vsg::Data>();
-            if (imageTile)
-            {
-                auto tile_extents = computeTileExtents(tileID.local_x, tileID.local_y, local_lod);
-                auto tile = createTile(tile_extents, imageTile);
-                if (tile)
-                {
-                    vsg::ComputeBounds computeBound;
-                    tile->accept(computeBound);
-                    auto& bb = computeBound.bounds;
-                    vsg::dsphere bound((bb.min.x + bb.max.x) * 0.5, (bb.min.y + bb.max.y) * 0.5, (bb.min.z + bb.max.z) * 0.5, vsg::length(bb.max - bb.min) * 0.5);
-
-                    if (local_lod < maxLevel)
-                    {
-                        auto plod = vsg::PagedLOD::create();
-                        plod->bound = bound;
-                        plod->children[0] = vsg::PagedLOD::Child{lodTransitionScreenHeightRatio, {}}; // external child visible when it's bound occupies more than 1/4 of the height of the window
-                        plod->children[1] = vsg::PagedLOD::Child{0.0, tile};                          // visible always
-                        plod->filename = vsg::make_string(tileID.local_x, " ", tileID.local_y, " ", local_lod, ".tile");
-                        plod->options = options;
-
-                        //std::cout<<"plod->filename "<<plod->filename<<std::endl;
-
-                        group->addChild(plod);
-                    }
-                    else
-                    {
-                        auto cullGroup = vsg::CullGroup::create();
-                        cullGroup->bound = bound;
-                        cullGroup->addChild(tile);
-
-                        group->addChild(cullGroup);
-                    }
-                }
-            }
+            options->operationThreads->add(operations[i], vsg::INSERT_FRONT);
         }
-    }
+        operations[0]->run();
+        options->operationThreads->run();
 
-    vsg::time_point end_read = vsg::clock::now();
-
-    double time_to_read_tile = std::chrono::duration<float, std::chrono::milliseconds::period>(end_read - start_read).count();
+        latch->wait();
+    }
+    else
+    {
+        for (auto& operation : operations) operation->run();
+    }
 
+    for (auto& operation : operations)
     {
-        std::scoped_lock<std::mutex> lock(statsMutex);
-        numTilesRead += 1;
-        totalTimeReadingTiles += time_to_read_tile;
+        if (operation->subtile) group->addChild(operation->subtile);
     }
 
     if (group->children.size() != 4)
@@ -235,11 +442,48 @@ vsg::ref_ptr<vsg::Object> TileReader::read_subtile(uint32_t x, uint32_t y, uint3
     return group;
 }
 
+vsg::ref_ptr<vsg::Node> TileReader::createSubtile(uint32_t x, uint32_t y, uint32_t lod, vsg::ref_ptr<vsg::Node> tile, vsg::ref_ptr<const vsg::Options> options) const
+{
+    auto start = vsg::clock::now();
+
+    vsg::ComputeBounds computeBound;
+    tile->accept(computeBound);
+    auto& bb = computeBound.bounds;
+    vsg::dsphere bound((bb.min.x + bb.max.x) * 0.5, (bb.min.y + bb.max.y) * 0.5, (bb.min.z + bb.max.z) * 0.5, vsg::length(bb.max - bb.min) * 0.5);
+
+    if (lod < maxLevel)
+    {
+        auto plod = vsg::PagedLOD::create();
+        plod->bound = bound;
+        plod->children[0] = vsg::PagedLOD::Child{lodTransitionScreenHeightRatio, {}}; // external child visible when it's bound occupies more than 1/4 of the height of the window
+        plod->children[1] = vsg::PagedLOD::Child{0.0, tile};                          // visible always
+        plod->filename = vsg::make_string(x, " ", y, " ", lod, ".tile");
+        plod->options = options;
+
+        //std::cout<<"plod->filename "<<plod->filename<<std::endl;
+
+        stats->addStage(TileStats::BOUNDS, start);
+
+        return plod;
+    }
+    else
+    {
+        auto cullGroup = vsg::CullGroup::create();
+        cullGroup->bound = bound;
+        cullGroup->addChild(tile);
+
+        stats->addStage(TileStats::BOUNDS, start);
+
+        return cullGroup;
+    }
+}
+
 void TileReader::init()
 {
-    // set up graphics pipeline
+    // set up graphics pipeline, with a texture pool the descriptor set holds the array of all the pool's textures
+    uint32_t numTextures = texturePool ? texturePool->numTextures : 1;
     vsg::DescriptorSetLayoutBindings descriptorBindings{
-        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr} // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, numTextures, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr} // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
     };
 
     descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
@@ -247,6 +491,7 @@ void TileReader::init()
     vsg::PushConstantRanges pushConstantRanges{
         {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // projection view, and model matrices, actual push constant calls autoaatically provided by the VSG's DispatchTraversal
     };
+    if (texturePool) pushConstantRanges.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, 128, 4}); // index of the tile's texture in the pool
 
     pipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{descriptorSetLayout}, pushConstantRanges);
 
@@ -257,16 +502,82 @@ void TileReader::init()
     sampler->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     sampler->anisotropyEnable = VK_TRUE;
     sampler->maxAnisotropy = 16.0f;
+
+    if (texturePool) texturePool->sampler = sampler;
+
+    // with terrain the tiles have a skirt hanging down from their edges to hide the cracks between neighbouring tiles of different levels,
+    // the skirt vertices follow the grid vertices, one per vertex around the edge of the grid in counter clockwise order.
+    skirtPerimeter.clear();
+    if (!terrainLayer.empty())
+    {
+        for (uint32_t c = 0; c < numCols - 1; ++c) skirtPerimeter.push_back(c);
+        for (uint32_t r = 0; r < numRows - 1; ++r) skirtPerimeter.push_back(numCols - 1 + r * numCols);
+        for (uint32_t c = numCols - 1; c > 0; --c) skirtPerimeter.push_back(c + (numRows - 1) * numCols);
+        for (uint32_t r = numRows - 1; r > 0; --r) skirtPerimeter.push_back(r * numCols);
+    }
+
+    // set up the colours and indices shared by all tiles
+    uint32_t numGridVertices = numRows * numCols;
+    uint32_t numSkirtVertices = static_cast<uint32_t>(skirtPerimeter.size());
+    uint32_t numVertices = numGridVertices + numSkirtVertices;
+    uint32_t numTriangles = (numRows - 1) * (numCols - 1) * 2 + numSkirtVertices * 2;
+
+    colors = vsg::vec3Array::create(numVertices);
+    for (auto& color : *colors) color.set(1.0f, 1.0f, 1.0f);
+
+    indices = vsg::ushortArray::create(numTriangles * 3);
+    auto itr = indices->begin();
+    for (uint32_t r = 0; r < numRows - 1; ++r)
+    {
+        for (uint32_t c = 0; c < numCols - 1; ++c)
+        {
+            uint32_t vi = c + r * numCols;
+            (*itr++) = vi;
+            (*itr++) = vi + 1;
+            (*itr++) = vi + numCols;
+            (*itr++) = vi + numCols;
+            (*itr++) = vi + 1;
+            (*itr++) = vi + numCols + 1;
+        }
+    }
+
+    for (uint32_t i = 0; i < numSkirtVertices; ++i)
+    {
+        uint32_t next = (i + 1) % numSkirtVertices;
+        (*itr++) = skirtPerimeter[i];
+        (*itr++) = numGridVertices + i;
+        (*itr++) = skirtPerimeter[next];
+        (*itr++) = skirtPerimeter[next];
+        (*itr++) = numGridVertices + i;
+        (*itr++) = numGridVertices + next;
+    }
 }
 
-vsg::ref_ptr<vsg::StateGroup> TileReader::createRoot() const
+vsg::ref_ptr<vsg::StateGroup> TileReader::createRoot(vsg::ref_ptr<const vsg::Options> options) const
 {
     // set up search paths to SPIRV shaders and textures
     vsg::Paths searchPaths = vsg::getEnvPaths("VSG_FILE_PATH");
 
     // load shaders
-    vsg::ref_ptr<vsg::ShaderStage> vertexShader = vsg::ShaderStage::read(VK_SHADER_STAGE_VERTEX_BIT, "main", vsg::findFile("shaders/vert_PushConstants.spv", searchPaths));
-    vsg::ref_ptr<vsg::ShaderStage> fragmentShader = vsg::ShaderStage::read(VK_SHADER_STAGE_FRAGMENT_BIT, "main", vsg::findFile("shaders/frag_PushConstants.spv", searchPaths));
+    vsg::ref_ptr<vsg::ShaderStage> vertexShader;
+    vsg::ref_ptr<vsg::ShaderStage> fragmentShader;
+    if (texturePool)
+    {
+        vertexShader = vsg::read_cast<vsg::ShaderStage>("shaders/shader_PushConstants.vert", options);
+        fragmentShader = vsg::read_cast<vsg::ShaderStage>("shaders/tiletexturepool.frag", options);
+        if (fragmentShader)
+        {
+            fragmentShader->specializationConstants = vsg::ShaderStage::SpecializationConstants{
+                {0, vsg::uintValue::create(texturePool->numTextures)} // numTextures
+            };
+        }
+    }
+    else
+    {
+        vertexShader = vsg::ShaderStage::read(VK_SHADER_STAGE_VERTEX_BIT, "main", vsg::findFile("shaders/vert_PushConstants.spv", searchPaths));
+        fragmentShader = vsg::ShaderStage::read(VK_SHADER_STAGE_FRAGMENT_BIT, "main", vsg::findFile("shaders/frag_PushConstants.spv", searchPaths));
+    }
+
     if (!vertexShader || !fragmentShader)
     {
         std::cout << "Could not create shaders." << std::endl;
@@ -302,21 +613,37 @@ vsg::ref_ptr<vsg::StateGroup> TileReader::createRoot() const
     return root;
 }
 
-vsg::ref_ptr<vsg::Node> TileReader::createTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const
+vsg::ref_ptr<vsg::Node> TileReader::createTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData, vsg::ref_ptr<vsg::Data> terrainData) const
 {
 #if 1
-    return createECEFTile(tile_extents, sourceData);
+    return createECEFTile(tile_extents, sourceData, terrainData);
 #else
     return createTextureQuad(tile_extents, sourceData);
 #endif
 }
 
-vsg::ref_ptr<vsg::Node> TileReader::createECEFTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> textureData) const
+vsg::ref_ptr<vsg::Node> TileReader::createECEFTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> textureData, vsg::ref_ptr<vsg::Data> terrainData) const
 {
-    vsg::dvec3 center = computeLatitudeLongitudeAltitude((tile_extents.min + tile_extents.max) * 0.5);
+    return createTextureState(textureData, createECEFGeometry(tile_extents, textureData, terrainData));
+}
 
-    auto localToWorld = ellipsoidModel->computeLocalToWorldTransform(center);
-    auto worldToLocal = vsg::inverse(localToWorld);
+vsg::ref_ptr<vsg::StateGroup> TileReader::createTextureState(vsg::ref_ptr<vsg::Data> textureData, vsg::ref_ptr<vsg::Node> geometry) const
+{
+    if (texturePool)
+    {
+        // the pool's textures are already bound at the root so the tile just needs to select its texture
+        auto texture = texturePool->acquire(textureData);
+        if (!texture) return {};
+
+        auto scenegraph = vsg::StateGroup::create();
+        scenegraph->add(vsg::PushConstants::create(VK_SHADER_STAGE_FRAGMENT_BIT, 128, vsg::uintValue::create(texture->index)));
+        scenegraph->addChild(geometry);
+
+        // the texture is returned to the pool when the tile is deleted
+        scenegraph->setObject("Texture", texture);
+
+        return scenegraph;
+    }
 
     // create texture image and associated DescriptorSets and binding
     auto texture = vsg::DescriptorImage::create(sampler, textureData, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
@@ -327,22 +654,23 @@ vsg::ref_ptr<vsg::Node> TileReader::createECEFTile(const vsg::dbox& tile_extents
     // create StateGroup to bind any texture state
     auto scenegraph = vsg::StateGroup::create();
     scenegraph->add(bindDescriptorSets);
+    scenegraph->addChild(geometry);
 
-    // set up model transformation node
-    auto transform = vsg::MatrixTransform::create(localToWorld); // VK_SHADER_STAGE_VERTEX_BIT
+    return scenegraph;
+}
 
-    // add transform to root of the scene graph
-    scenegraph->addChild(transform);
+vsg::ref_ptr<vsg::MatrixTransform> TileReader::createECEFGeometry(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> textureData, vsg::ref_ptr<vsg::Data> terrainData) const
+{
+    vsg::dvec3 center = computeLatitudeLongitudeAltitude((tile_extents.min + tile_extents.max) * 0.5);
 
-    uint32_t numRows = 32;
-    uint32_t numCols = 32;
-    uint32_t numVertices = numRows * numCols;
-    uint32_t numTriangles = (numRows - 1) * (numCols - 1) * 2;
+    auto localToWorld = ellipsoidModel->computeLocalToWorldTransform(center);
+    auto worldToLocal = vsg::inverse(localToWorld);
 
-    double longitudeOrigin = tile_extents.min.x;
-    double longitudeScale = (tile_extents.max.x - tile_extents.min.x) / double(numCols - 1);
-    double latitudeOrigin = tile_extents.min.y;
-    double latitudeScale = (tile_extents.max.y - tile_extents.min.y) / double(numRows - 1);
+    // set up model transformation node
+    auto transform = vsg::MatrixTransform::create(localToWorld); // VK_SHADER_STAGE_VERTEX_BIT
+
+    uint32_t numGridVertices = numRows * numCols;
+    uint32_t numVertices = numGridVertices + static_cast<uint32_t>(skirtPerimeter.size());
 
     float sCoordScale = 1.0f / float(numCols - 1);
     float tCoordScale = 1.0f / float(numRows - 1);
@@ -353,44 +681,32 @@ vsg::ref_ptr<vsg::Node> TileReader::createECEFTile(const vsg::dbox& tile_extents
         tCoordOrigin = 1.0f;
     }
 
-    vsg::vec3 color(1.0f, 1.0f, 1.0f);
-
     // set up vertex coords
+    std::vector<float> heights;
+    if (terrainData) sampleHeights(terrainData, heights);
+
     auto vertices = vsg::vec3Array::create(numVertices);
-    auto colors = vsg::vec3Array::create(numVertices);
+    computeECEFGrid(tile_extents, worldToLocal, heights.empty() ? nullptr : heights.data(), vertices->data());
+
     auto texcoords = vsg::vec2Array::create(numVertices);
     for (uint32_t r = 0; r < numRows; ++r)
     {
         for (uint32_t c = 0; c < numCols; ++c)
         {
-            vsg::dvec3 location(longitudeOrigin + double(c) * longitudeScale, latitudeOrigin + double(r) * latitudeScale, 0.0);
-            vsg::dvec3 latitudeLongitudeAltitude = computeLatitudeLongitudeAltitude(location);
-
-            auto ecef = ellipsoidModel->convertLatLongAltitudeToECEF(latitudeLongitudeAltitude);
-            vsg::vec3 vertex(worldToLocal * ecef);
-            vsg::vec2 texcoord(float(c) * sCoordScale, tCoordOrigin + float(r) * tCoordScale);
-
-            uint32_t vi = c + r * numCols;
-            vertices->set(vi, vertex);
-            colors->set(vi, color);
-            texcoords->set(vi, texcoord);
+            texcoords->set(c + r * numCols, vsg::vec2(float(c) * sCoordScale, tCoordOrigin + float(r) * tCoordScale));
         }
     }
 
-    // set up indices
-    auto indices = vsg::ushortArray::create(numTriangles * 3);
-    auto itr = indices->begin();
-    for (uint32_t r = 0; r < numRows - 1; ++r)
+    // the skirt vertices are dropped below the edge vertices along the tile's local up axis
+    if (!skirtPerimeter.empty())
     {
-        for (uint32_t c = 0; c < numCols - 1; ++c)
+        float skirtDepth = static_cast<float>(skirtRatio) * vsg::length(vertices->at(numGridVertices - 1) - vertices->at(0));
+        for (std::size_t i = 0; i < skirtPerimeter.size(); ++i)
         {
-            uint32_t vi = c + r * numCols;
-            (*itr++) = vi;
-            (*itr++) = vi + 1;
-            (*itr++) = vi + numCols;
-            (*itr++) = vi + numCols;
-            (*itr++) = vi + 1;
-            (*itr++) = vi + numCols + 1;
+            auto vertex = vertices->at(skirtPerimeter[i]);
+            vertex.z -= skirtDepth;
+            vertices->set(numGridVertices + i, vertex);
+            texcoords->set(numGridVertices + i, texcoords->at(skirtPerimeter[i]));
         }
     }
 
@@ -403,7 +719,120 @@ vsg::ref_ptr<vsg::Node> TileReader::createECEFTile(const vsg::dbox& tile_extents
     // add drawCommands to transform
     transform->addChild(drawCommands);
 
-    return scenegraph;
+    return transform;
+}
+
+void TileReader::sampleHeights(vsg::ref_ptr<vsg::Data> terrainData, std::vector<float>& heights) const
+{
+    auto heightField = terrainData.cast<vsg::floatArray2D>();
+    if (!heightField || heightField->width() < 2 || heightField->height() < 2)
+    {
+        std::cout << "Warning: unsupported terrain data " << terrainData->className() << ", expected a floatArray2D." << std::endl;
+        return;
+    }
+
+    // bilinear interpolation of the height field at each grid vertex, rows run from the south edge of the tile to the north edge
+    bool flip = terrainData->getLayout().origin == vsg::TOP_LEFT;
+    uint32_t width = heightField->width();
+    uint32_t height = heightField->height();
+
+    auto heightAt = [&](uint32_t i, uint32_t j) -> float {
+        float value = heightField->at(i, j);
+        // treat no data values, which are typically large negative values, as sea level
+        return (value > -12000.0f && value < 10000.0f) ? value : 0.0f;
+    };
+
+    heights.resize(numRows * numCols);
+    for (uint32_t r = 0; r < numRows; ++r)
+    {
+        double v = double(r) / double(numRows - 1);
+        double fj = (flip ? (1.0 - v) : v) * double(height - 1);
+        uint32_t j = std::min(static_cast<uint32_t>(fj), height - 2);
+        float tj = static_cast<float>(fj - double(j));
+
+        for (uint32_t c = 0; c < numCols; ++c)
+        {
+            double fi = double(c) / double(numCols - 1) * double(width - 1);
+            uint32_t i = std::min(static_cast<uint32_t>(fi), width - 2);
+            float ti = static_cast<float>(fi - double(i));
+
+            float h0 = heightAt(i, j) * (1.0f - ti) + heightAt(i + 1, j) * ti;
+            float h1 = heightAt(i, j + 1) * (1.0f - ti) + heightAt(i + 1, j + 1) * ti;
+            heights[c + r * numCols] = h0 * (1.0f - tj) + h1 * tj;
+        }
+    }
+}
+
+void TileReader::computeECEFGrid(const vsg::dbox& tile_extents, const vsg::dmat4& worldToLocal, const float* heights, vsg::vec3* vertices) const
+{
+    // the grid is regular in latitude and longitude so the trig functions are only needed once per row and once per column,
+    // leaving the inner loop as straight arithmetic over contiguous arrays that the compiler can vectorize.
+    double longitudeOrigin = tile_extents.min.x;
+    double longitudeScale = (tile_extents.max.x - tile_extents.min.x) / double(numCols - 1);
+    double latitudeOrigin = tile_extents.min.y;
+    double latitudeScale = (tile_extents.max.y - tile_extents.min.y) / double(numRows - 1);
+
+    std::vector<double> cosLongitudes(numCols);
+    std::vector<double> sinLongitudes(numCols);
+    for (uint32_t c = 0; c < numCols; ++c)
+    {
+        double longitude = vsg::radians(computeLatitudeLongitudeAltitude(vsg::dvec3(longitudeOrigin + double(c) * longitudeScale, 0.0, 0.0)).y);
+        cosLongitudes[c] = cos(longitude);
+        sinLongitudes[c] = sin(longitude);
+    }
+
+    double radiusEquator = ellipsoidModel->radiusEquator();
+    double radiusPolar = ellipsoidModel->radiusPolar();
+    double eccentricitySquared = (radiusEquator * radiusEquator - radiusPolar * radiusPolar) / (radiusEquator * radiusEquator);
+
+    const auto& m = worldToLocal;
+    for (uint32_t r = 0; r < numRows; ++r)
+    {
+        double latitude = vsg::radians(computeLatitudeLongitudeAltitude(vsg::dvec3(0.0, latitudeOrigin + double(r) * latitudeScale, 0.0)).x);
+        double sinLatitude = sin(latitude);
+        double cosLatitude = cos(latitude);
+        double N = radiusEquator / sqrt(1.0 - eccentricitySquared * sinLatitude * sinLatitude);
+
+        const double* cosLongitude = cosLongitudes.data();
+        const double* sinLongitude = sinLongitudes.data();
+        vsg::vec3* row = vertices + r * numCols;
+
+        if (!heights)
+        {
+            // ecef = (a * cosLongitude, a * sinLongitude, z), with the z and translation contributions constant along the row
+            double a = N * cosLatitude;
+            double z = N * (1.0 - eccentricitySquared) * sinLatitude;
+            double bx = m[2][0] * z + m[3][0];
+            double by = m[2][1] * z + m[3][1];
+            double bz = m[2][2] * z + m[3][2];
+
+            for (uint32_t c = 0; c < numCols; ++c)
+            {
+                double x = a * cosLongitude[c];
+                double y = a * sinLongitude[c];
+                row[c].x = static_cast<float>(m[0][0] * x + m[1][0] * y + bx);
+                row[c].y = static_cast<float>(m[0][1] * x + m[1][1] * y + by);
+                row[c].z = static_cast<float>(m[0][2] * x + m[1][2] * y + bz);
+            }
+        }
+        else
+        {
+            const float* rowHeights = heights + r * numCols;
+            double Ne = N * (1.0 - eccentricitySquared);
+
+            for (uint32_t c = 0; c < numCols; ++c)
+            {
+                double h = rowHeights[c];
+                double a = (N + h) * cosLatitude;
+                double x = a * cosLongitude[c];
+                double y = a * sinLongitude[c];
+                double z = (Ne + h) * sinLatitude;
+                row[c].x = static_cast<float>(m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0]);
+                row[c].y = static_cast<float>(m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1]);
+                row[c].z = static_cast<float>(m[0][2] * x + m[1][2] * y + m[2][2] * z + m[3][2]);
+            }
+        }
+    }
 }
 
 vsg::ref_ptr<vsg::Node> TileReader::createTextureQuad(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> textureData) const
@@ -2,6 +2,27 @@
 
 #include <vsg/all.h>
 
+#include <atomic>
+#include <list>
+#include <map>
+#include <tuple>
+
+#include "ImageCompressor.h"
+#include "TileCache.h"
+#include "TileScheduler.h"
+#include "TileStats.h"
+#include "TileTexturePool.h"
+
+struct TileID
+{
+    uint32_t x;
+    uint32_t y;
+    uint32_t level;
+
+    bool operator==(const TileID& rhs) const { return x == rhs.x && y == rhs.y && level == rhs.level; }
+    bool operator<(const TileID& rhs) const { return std::tie(level, y, x) < std::tie(rhs.level, rhs.y, rhs.x); }
+};
+
 class TileReader : public vsg::Inherit<vsg::ReaderWriter, TileReader>
 {
 public:
@@ -20,14 +41,44 @@ public:
     vsg::Path terrainLayer;
     uint32_t mipmapLevelsHint = 16;
 
+    // depth of the skirts added to tiles when a terrainLayer is assigned, as a ratio of the tile's size
+    double skirtRatio = 0.02;
+
+    // optional persistent cache of tile images and geometry
+    vsg::ref_ptr<TileCache> tileCache;
+
+    // optional compression of the imagery as it's read
+    vsg::ref_ptr<ImageCompressor> imageCompressor;
+
+    // optional prioritisation and capping of the subtile reads requested by the DatabasePager
+    vsg::ref_ptr<TileScheduler> tileScheduler;
+
+    // optional pool of textures shared by all tiles through a single descriptor set, must be assigned before init()
+    vsg::ref_ptr<TileTexturePool> texturePool;
+
     void init();
 
     vsg::ref_ptr<vsg::Object> read(const vsg::Path& filename, vsg::ref_ptr<const vsg::Options> options = {}) const override;
 
-    // timing stats
-    mutable std::mutex statsMutex;
-    mutable uint64_t numTilesRead{0};
-    mutable double totalTimeReadingTiles{0.0};
+    // compute the tile at the specified level that contains latitude, longitude, returns false if it's outside the extents
+    bool computeTile(double latitude, double longitude, uint32_t level, uint32_t& x, uint32_t& y) const;
+
+    // hash of the settings that determine the tiles' images and geometry, used to tell whether a tileCache holds tiles compatible with this TileReader
+    uint64_t computeCacheSignature() const;
+
+    // approximate bound of a tile, for use before its geometry has been created
+    vsg::dsphere computeTileBound(uint32_t x, uint32_t y, uint32_t level) const;
+
+    // read the subtiles of tile ahead of the DatabasePager requesting them, holding on to them until read() is called for that tile
+    bool prefetch(const TileID& tile, vsg::ref_ptr<const vsg::Options> options) const;
+
+    // maximum number of prefetched tiles held on to, once exceeded the oldest are discarded
+    uint32_t maxPrefetchedTiles = 64;
+    mutable std::atomic<uint64_t> numPrefetchedTilesUsed{0};
+    mutable std::atomic<uint64_t> numPrefetchedTilesDiscarded{0};
+
+    // load time stats
+    vsg::ref_ptr<TileStats> stats = TileStats::create();
 
 protected:
     vsg::dvec3 computeLatitudeLongitudeAltitude(const vsg::dvec3& src) const;
@@ -35,15 +86,51 @@ protected:
     vsg::Path getTilePath(const vsg::Path& src, uint32_t x, uint32_t y, uint32_t level) const;
 
     vsg::ref_ptr<vsg::Object> read_root(vsg::ref_ptr<const vsg::Options> options = {}) const;
+    vsg::ref_ptr<vsg::Object> takePrefetched(const TileID& tile) const;
+
     vsg::ref_ptr<vsg::Object> read_subtile(uint32_t x, uint32_t y, uint32_t lod, vsg::ref_ptr<const vsg::Options> options = {}) const;
 
-    vsg::ref_ptr<vsg::Node> createTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const;
-    vsg::ref_ptr<vsg::Node> createECEFTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const;
+    // read the image, and terrain when a terrainLayer is assigned, for a tile
+    bool readTileData(uint32_t x, uint32_t y, uint32_t lod, vsg::ref_ptr<const vsg::Options> options, vsg::ref_ptr<vsg::Data>& imageTile, vsg::ref_ptr<vsg::Data>& terrainTile) const;
+
+    // read the tile from the tileCache if available, otherwise read its image and create it, adding it to the tileCache
+    vsg::ref_ptr<vsg::Node> readTile(uint32_t x, uint32_t y, uint32_t lod, vsg::ref_ptr<const vsg::Options> options) const;
+
+    // create the PagedLOD, or CullGroup for the last level, for a subtile
+    vsg::ref_ptr<vsg::Node> createSubtile(uint32_t x, uint32_t y, uint32_t lod, vsg::ref_ptr<vsg::Node> tile, vsg::ref_ptr<const vsg::Options> options) const;
+
+    // reads and creates a single subtile on one of the options->operationThreads
+    struct ReadSubtileOperation;
+
+    vsg::ref_ptr<vsg::Node> createTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData, vsg::ref_ptr<vsg::Data> terrainData = {}) const;
+    vsg::ref_ptr<vsg::Node> createECEFTile(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData, vsg::ref_ptr<vsg::Data> terrainData = {}) const;
     vsg::ref_ptr<vsg::Node> createTextureQuad(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> sourceData) const;
 
-    vsg::ref_ptr<vsg::StateGroup> createRoot() const;
+    vsg::ref_ptr<vsg::StateGroup> createTextureState(vsg::ref_ptr<vsg::Data> textureData, vsg::ref_ptr<vsg::Node> geometry) const;
+    vsg::ref_ptr<vsg::MatrixTransform> createECEFGeometry(const vsg::dbox& tile_extents, vsg::ref_ptr<vsg::Data> textureData, vsg::ref_ptr<vsg::Data> terrainData = {}) const;
+
+    // sample the terrain height field at each of the numRows x numCols grid vertices
+    void sampleHeights(vsg::ref_ptr<vsg::Data> terrainData, std::vector<float>& heights) const;
+
+    // compute the numRows x numCols grid of vertices spanning tile_extents, at the optional per vertex heights, transformed into the tile's local coordinate frame
+    void computeECEFGrid(const vsg::dbox& tile_extents, const vsg::dmat4& worldToLocal, const float* heights, vsg::vec3* vertices) const;
+
+    vsg::ref_ptr<vsg::StateGroup> createRoot(vsg::ref_ptr<const vsg::Options> options) const;
 
     vsg::ref_ptr<vsg::DescriptorSetLayout> descriptorSetLayout;
     vsg::ref_ptr<vsg::PipelineLayout> pipelineLayout;
     vsg::ref_ptr<vsg::Sampler> sampler;
+
+    // all ECEF tiles share the same grid dimensions so the colours and indices are set up once in init() and shared between tiles
+    uint32_t numRows = 32;
+    uint32_t numCols = 32;
+    vsg::ref_ptr<vsg::vec3Array> colors;
+    vsg::ref_ptr<vsg::ushortArray> indices;
+
+    // grid vertices around the edge of the tile that the skirt hangs from, empty when there's no terrain
+    std::vector<uint32_t> skirtPerimeter;
+
+    mutable std::mutex prefetchMutex;
+    mutable std::map<TileID, vsg::ref_ptr<vsg::Object>> prefetchedTiles;
+    mutable std::list<TileID> prefetchOrder;
 };
@@ -0,0 +1,142 @@
+#include "TileScheduler.h"
+
+#include <cmath>
+#include <iostream>
+
+TileScheduler::TileScheduler(vsg::ref_ptr<vsg::Camera> in_camera, uint32_t in_maxConcurrentReads) :
+    camera(in_camera),
+    maxConcurrentReads(in_maxConcurrentReads)
+{
+}
+
+void TileScheduler::apply(vsg::FrameEvent& /*frame*/)
+{
+    auto viewMatrix = camera->viewMatrix->transform();
+    auto projectionMatrix = camera->projectionMatrix->transform();
+    auto m = projectionMatrix * viewMatrix;
+
+    // left, right, bottom and top planes of the view frustum, the near and far planes are left out as they add little for tiles
+    auto row = [&m](int i) { return vsg::dvec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+    vsg::dvec4 planes[4] = {row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1)};
+    for (auto& plane : planes)
+    {
+        double length = vsg::length(vsg::dvec3(plane.x, plane.y, plane.z));
+        if (length > 0.0) plane = plane / length;
+    }
+
+    auto inverseView = vsg::inverse(viewMatrix);
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    for (int i = 0; i < 4; ++i) _frustumPlanes[i] = planes[i];
+    _eye.set(inverseView[3][0], inverseView[3][1], inverseView[3][2]);
+    _hasView = true;
+
+    schedule();
+}
+
+bool TileScheduler::visible(const Request& request) const
+{
+    if (!_hasView) return true;
+
+    auto& center = request.bound.center;
+    for (auto& plane : _frustumPlanes)
+    {
+        if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -request.bound.radius) return false;
+    }
+    return true;
+}
+
+double TileScheduler::screenSpaceSize(const Request& request) const
+{
+    if (!_hasView) return 0.0;
+
+    double distance = vsg::length(request.bound.center - _eye) - request.bound.radius;
+    return request.bound.radius / std::max(distance, request.bound.radius * 0.01);
+}
+
+void TileScheduler::schedule()
+{
+    bool changed = false;
+
+    // drop requests that have gone out of view
+    for (auto itr = _waiting.begin(); itr != _waiting.end();)
+    {
+        if (!visible(**itr))
+        {
+            (*itr)->dropped = true;
+            itr = _waiting.erase(itr);
+            ++numDropped;
+            changed = true;
+        }
+        else
+        {
+            ++itr;
+        }
+    }
+
+    // grant the requests for the tiles occupying the most screen space, coarsely bucketed so that the most recent requests win between tiles of similar size
+    auto key = [&](const Request* request) { return std::make_pair(std::floor(std::log2(screenSpaceSize(*request) + 1e-6)), request->sequence); };
+    while (_numActive < maxConcurrentReads && !_waiting.empty())
+    {
+        auto best = _waiting.begin();
+        for (auto itr = std::next(best); itr != _waiting.end(); ++itr)
+        {
+            if (key(*best) < key(*itr)) best = itr;
+        }
+
+        (*best)->granted = true;
+        _waiting.erase(best);
+        ++_numActive;
+        ++numGranted;
+        changed = true;
+    }
+
+    if (changed) _cv.notify_all();
+}
+
+bool TileScheduler::acquire(const vsg::dsphere& bound)
+{
+    Request request;
+    request.bound = bound;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    request.sequence = ++_sequence;
+    if (!visible(request))
+    {
+        ++numDropped;
+        return false;
+    }
+
+    if (_numActive < maxConcurrentReads && _waiting.empty())
+    {
+        ++_numActive;
+        ++numGranted;
+        return true;
+    }
+
+    _waiting.push_back(&request);
+    ++numWaited;
+    if (_waiting.size() > maxNumWaiting) maxNumWaiting = _waiting.size();
+
+    schedule();
+
+    _cv.wait(lock, [&request]() { return request.granted || request.dropped; });
+
+    return request.granted;
+}
+
+void TileScheduler::release()
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    if (_numActive > 0) --_numActive;
+
+    schedule();
+}
+
+void TileScheduler::report(std::ostream& out) const
+{
+    out << "tile scheduler : granted = " << numGranted << ", dropped = " << numDropped << ", waited = " << numWaited << ", max waiting = " << maxNumWaiting << std::endl;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+
+////////////////////////////////////////////////////////////
+// TileScheduler.h
+//
+// The DatabasePager's read threads call TileReader::read() in the order the requests were made, so tiles
+// requested while the camera was looking elsewhere are still fetched and built after they are no longer
+// needed. TileScheduler sits in front of TileReader::read_subtile(), capping the number of concurrent
+// tile reads and, when more reads are waiting than can run, granting them by screen space size then
+// recency. Requests whose tile has moved outside the view frustum are dropped, the DatabasePager will
+// request them again if they come back into view.
+//
+
+class TileScheduler : public vsg::Inherit<vsg::Visitor, TileScheduler>
+{
+public:
+    TileScheduler(vsg::ref_ptr<vsg::Camera> in_camera, uint32_t in_maxConcurrentReads = 2);
+
+    vsg::ref_ptr<vsg::Camera> camera;
+    uint32_t maxConcurrentReads;
+
+    // snapshot the camera's view each frame and reschedule the waiting requests against it
+    void apply(vsg::FrameEvent& frame) override;
+
+    // block until a read of the tile with the specified bound can proceed, returns false if the request was dropped.
+    // each successful acquire() must be paired with a release() once the read has completed.
+    bool acquire(const vsg::dsphere& bound);
+    void release();
+
+    // stats
+    std::atomic<uint64_t> numGranted{0};
+    std::atomic<uint64_t> numDropped{0};
+    std::atomic<uint64_t> numWaited{0};
+    std::atomic<uint64_t> maxNumWaiting{0};
+
+    void report(std::ostream& out) const;
+
+protected:
+    struct Request
+    {
+        vsg::dsphere bound;
+        uint64_t sequence = 0;
+        bool granted = false;
+        bool dropped = false;
+    };
+
+    bool visible(const Request& request) const;
+    double screenSpaceSize(const Request& request) const;
+
+    // grant or drop waiting requests, must be called with _mutex locked
+    void schedule();
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::list<Request*> _waiting;
+    uint32_t _numActive = 0;
+    uint64_t _sequence = 0;
+
+    // view snapshot, no requests are dropped until the first frame
+    bool _hasView = false;
+    vsg::dvec3 _eye;
+    vsg::dvec4 _frustumPlanes[4];
+};
@@ -0,0 +1,96 @@
+#include "TileStats.h"
+
+#include <iostream>
+
+namespace
+{
+    uint64_t microsecondsSince(vsg::time_point start, vsg::time_point end)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+    }
+}
+
+const char* TileStats::stageName(Stage stage)
+{
+    switch (stage)
+    {
+    case (SCHEDULE): return "schedule";
+    case (QUEUE): return "queue";
+    case (CACHE): return "cache";
+    case (READ): return "read";
+    case (COMPRESS): return "compress";
+    case (GEOMETRY): return "geometry";
+    case (BOUNDS): return "bounds";
+    default: return "unknown";
+    }
+}
+
+vsg::time_point TileStats::addStage(Stage stage, vsg::time_point start)
+{
+    auto now = vsg::clock::now();
+    stageCounts[stage].fetch_add(1, std::memory_order_relaxed);
+    stageMicroseconds[stage].fetch_add(microsecondsSince(start, now), std::memory_order_relaxed);
+    return now;
+}
+
+void TileStats::addTile(uint32_t level, vsg::time_point start)
+{
+    level = std::min(level, maxNumLevels - 1);
+    levelCounts[level].fetch_add(1, std::memory_order_relaxed);
+    levelMicroseconds[level].fetch_add(microsecondsSince(start, vsg::clock::now()), std::memory_order_relaxed);
+}
+
+void TileStats::addRequest(vsg::time_point start, bool succeeded)
+{
+    auto microseconds = microsecondsSince(start, vsg::clock::now());
+
+    numRequests.fetch_add(1, std::memory_order_relaxed);
+    if (!succeeded) numRequestsFailed.fetch_add(1, std::memory_order_relaxed);
+    requestMicroseconds.fetch_add(microseconds, std::memory_order_relaxed);
+
+    uint32_t bin = 0;
+    for (uint64_t milliseconds = microseconds / 1000; milliseconds > 0 && bin < numHistogramBins - 1; milliseconds >>= 1) ++bin;
+    latencyHistogram[bin].fetch_add(1, std::memory_order_relaxed);
+}
+
+void TileStats::report(std::ostream& out) const
+{
+    auto average = [](uint64_t microseconds, uint64_t count) { return count > 0 ? double(microseconds) / double(count) * 0.001 : 0.0; };
+
+    uint64_t requests = numRequests.load(std::memory_order_relaxed);
+    out << "tile requests : " << requests << ", failed = " << numRequestsFailed.load(std::memory_order_relaxed);
+    out << ", average latency = " << average(requestMicroseconds.load(std::memory_order_relaxed), requests) << "ms";
+    out << ", bytes read = " << numBytesRead.load(std::memory_order_relaxed) << std::endl;
+
+    out << "    stages :";
+    for (uint32_t i = 0; i < NUM_STAGES; ++i)
+    {
+        uint64_t count = stageCounts[i].load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        out << " " << stageName(static_cast<Stage>(i)) << " = " << average(stageMicroseconds[i].load(std::memory_order_relaxed), count) << "ms (" << count << ")";
+    }
+    out << std::endl;
+
+    out << "    levels :";
+    for (uint32_t i = 0; i < maxNumLevels; ++i)
+    {
+        uint64_t count = levelCounts[i].load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        out << " " << i << " = " << count << " tiles " << average(levelMicroseconds[i].load(std::memory_order_relaxed), count) << "ms";
+    }
+    out << std::endl;
+
+    out << "    latency histogram :";
+    for (uint32_t i = 0; i < numHistogramBins; ++i)
+    {
+        uint64_t count = latencyHistogram[i].load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        if (i == 0)
+            out << " <1ms = " << count;
+        else if (i == numHistogramBins - 1)
+            out << " >=" << (1u << (i - 1)) << "ms = " << count;
+        else
+            out << " " << (1u << (i - 1)) << "-" << (1u << i) << "ms = " << count;
+    }
+    out << std::endl;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+
+////////////////////////////////////////////////////////////
+// TileStats.h
+//
+// Breakdown of where the time loading tiles goes, to tell whether the tile server, the decoders or the
+// tile construction is the bottleneck. The TileReader records the time spent in each stage of loading
+// a tile, per level counts, the bytes of tile data read and a histogram of the latency of the subtile
+// requests made by the DatabasePager. Everything is held in relaxed atomics so the read threads never
+// contend on a lock, report() may be called at any time from another thread.
+//
+
+class TileStats : public vsg::Inherit<vsg::Object, TileStats>
+{
+public:
+    enum Stage
+    {
+        SCHEDULE, // waiting for the TileScheduler to grant a subtile request
+        QUEUE,    // waiting for an OperationThread to pick up a tile
+        CACHE,    // reading a tile from the TileCache
+        READ,     // fetching and decoding the image and terrain, vsgXchange's readers do both in a single call
+        COMPRESS, // compressing the image
+        GEOMETRY, // building the tile's geometry and state
+        BOUNDS,   // computing the tile's bounds and setting up its PagedLOD
+        NUM_STAGES
+    };
+
+    static constexpr uint32_t maxNumLevels = 32;
+
+    // latency histogram bins are powers of 2 in milliseconds, bin 0 < 1ms, bin i from 2^(i-1) to 2^i ms, with the last bin open ended
+    static constexpr uint32_t numHistogramBins = 16;
+
+    // add the time from start to now to a stage, returning now so consecutive stages can be chained
+    vsg::time_point addStage(Stage stage, vsg::time_point start);
+
+    // add a tile read at level, taking start to now
+    void addTile(uint32_t level, vsg::time_point start);
+
+    // add a completed subtile request to the latency histogram
+    void addRequest(vsg::time_point start, bool succeeded);
+
+    void addBytesRead(uint64_t numBytes) { numBytesRead.fetch_add(numBytes, std::memory_order_relaxed); }
+
+    std::atomic<uint64_t> stageCounts[NUM_STAGES] = {};
+    std::atomic<uint64_t> stageMicroseconds[NUM_STAGES] = {};
+
+    std::atomic<uint64_t> levelCounts[maxNumLevels] = {};
+    std::atomic<uint64_t> levelMicroseconds[maxNumLevels] = {};
+
+    std::atomic<uint64_t> numRequests{0};
+    std::atomic<uint64_t> numRequestsFailed{0};
+    std::atomic<uint64_t> requestMicroseconds{0};
+    std::atomic<uint64_t> latencyHistogram[numHistogramBins] = {};
+
+    std::atomic<uint64_t> numBytesRead{0};
+
+    void report(std::ostream& out) const;
+
+    static const char* stageName(Stage stage);
+};
@@ -0,0 +1,119 @@
+#include "TileTexturePool.h"
+
+#include <cstring>
+#include <iostream>
+
+TileTexturePool::TileTexturePool(uint32_t in_numTextures) :
+    numTextures(in_numTextures),
+    _initialImages(in_numTextures)
+{
+    // hand out the lowest indices first
+    for (uint32_t i = numTextures; i > 0; --i) _available.push_back(i - 1);
+}
+
+bool TileTexturePool::compatible(const vsg::Data& image) const
+{
+    return std::strcmp(image.className(), _template->className()) == 0 &&
+           image.getLayout().format == _template->getLayout().format &&
+           image.width() == _template->width() &&
+           image.height() == _template->height() &&
+           image.depth() == _template->depth() &&
+           image.dataSize() == _template->dataSize();
+}
+
+vsg::ref_ptr<TileTexturePool::Texture> TileTexturePool::acquire(vsg::ref_ptr<vsg::Data> image)
+{
+    if (!image) return {};
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    if (!_template) _template = image;
+
+    if (!compatible(*image))
+    {
+        ++numIncompatible;
+        return {};
+    }
+
+    // once the DescriptorImage has been created the images can only be assigned by copying them into the textures
+    if (!_imageInfos.empty() && !copyImages) return {};
+
+    if (_available.empty())
+    {
+        ++numFull;
+        return {};
+    }
+
+    uint32_t index = _available.back();
+    _available.pop_back();
+
+    if (_imageInfos.empty())
+    {
+        _initialImages[index] = image;
+    }
+    else
+    {
+        copyImages->copy(image, _imageInfos[index]);
+    }
+
+    ++_numInUse;
+    if (_numInUse > maxNumInUse) maxNumInUse = _numInUse;
+    ++numAcquired;
+
+    return Texture::create(this, index);
+}
+
+void TileTexturePool::release(uint32_t index)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    if (_imageInfos.empty())
+    {
+        // nothing can have been rendered with the texture yet so it can be reused straight away
+        _initialImages[index] = {};
+        _available.push_back(index);
+    }
+    else
+    {
+        _released.emplace_back(index, _frameCount);
+    }
+
+    --_numInUse;
+    ++numReleased;
+}
+
+vsg::ref_ptr<vsg::DescriptorImage> TileTexturePool::createDescriptorImage(uint32_t binding)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    if (!_template || !sampler || !_imageInfos.empty()) return {};
+
+    // the textures that haven't been assigned yet are created from the template image, their contents are replaced when they are acquired
+    _imageInfos.resize(numTextures);
+    for (uint32_t i = 0; i < numTextures; ++i)
+    {
+        _imageInfos[i] = vsg::ImageInfo::create(sampler, _initialImages[i] ? _initialImages[i] : _template);
+    }
+    _initialImages.clear();
+
+    return vsg::DescriptorImage::create(_imageInfos, binding, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+}
+
+void TileTexturePool::apply(vsg::FrameEvent& frame)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    _frameCount = frame.frameStamp->frameCount;
+
+    while (!_released.empty() && (_released.front().second + numFramesBeforeReuse) <= _frameCount)
+    {
+        _available.push_back(_released.front().first);
+        _released.pop_front();
+    }
+}
+
+void TileTexturePool::report(std::ostream& out) const
+{
+    out << "tile texture pool : textures = " << numTextures << ", acquired = " << numAcquired << ", released = " << numReleased << ", max in use = " << maxNumInUse;
+    out << ", full = " << numFull << ", incompatible = " << numIncompatible << std::endl;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vsg/all.h>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+////////////////////////////////////////////////////////////
+// TileTexturePool.h
+//
+// By default every tile has its own DescriptorImage, DescriptorSet and BindDescriptorSets, so with
+// thousands of tiles resident the descriptor pools have to be sized for the worst case and every tile
+// rebinds descriptor state. TileTexturePool instead holds a fixed array of tile sized textures bound
+// once, as a single DescriptorSet at the root of the database, with each tile selecting its texture
+// through a push constant. Tile imagery is copied into a free texture as the tile is created and the
+// texture is returned to the pool when the tile is deleted. All the tiles in a pool must have the same
+// dimensions, format and number of mipmaps, taken from the first tile assigned to the pool.
+//
+
+class TileTexturePool : public vsg::Inherit<vsg::Visitor, TileTexturePool>
+{
+public:
+    TileTexturePool(uint32_t in_numTextures);
+
+    // number of textures in the pool, which limits the number of tiles that can be resident at once
+    const uint32_t numTextures;
+
+    // number of frames a released texture is held back before reuse, so frames still in flight can finish sampling it
+    uint32_t numFramesBeforeReuse = 4;
+
+    // sampler shared by all the textures in the pool
+    vsg::ref_ptr<vsg::Sampler> sampler;
+
+    // command that copies tile imagery into the pool's textures, must be assigned and added to the CommandGraph before tiles are paged in
+    vsg::ref_ptr<vsg::CopyAndReleaseImage> copyImages;
+
+    // handle to a texture in the pool that returns the texture to the pool when deleted
+    class Texture : public vsg::Inherit<vsg::Object, Texture>
+    {
+    public:
+        Texture(TileTexturePool* in_pool, uint32_t in_index) :
+            pool(in_pool),
+            index(in_index) {}
+
+        vsg::ref_ptr<TileTexturePool> pool;
+        const uint32_t index;
+
+    protected:
+        virtual ~Texture() { pool->release(index); }
+    };
+
+    // assign image to a free texture, returns null if the pool is full or the image isn't compatible with the pool
+    vsg::ref_ptr<Texture> acquire(vsg::ref_ptr<vsg::Data> image);
+
+    // create the DescriptorImage for the array of textures, images acquired after this call are copied via copyImages.
+    vsg::ref_ptr<vsg::DescriptorImage> createDescriptorImage(uint32_t binding);
+
+    // track the frame count so released textures can be reused
+    void apply(vsg::FrameEvent& frame) override;
+
+    // stats
+    std::atomic<uint64_t> numAcquired{0};
+    std::atomic<uint64_t> numReleased{0};
+    std::atomic<uint64_t> numFull{0};
+    std::atomic<uint64_t> numIncompatible{0};
+    std::atomic<uint64_t> maxNumInUse{0};
+
+    void report(std::ostream& out) const;
+
+protected:
+    void release(uint32_t index);
+
+    bool compatible(const vsg::Data& image) const;
+
+    std::mutex _mutex;
+    uint64_t _frameCount = 0;
+    uint32_t _numInUse = 0;
+    std::vector<uint32_t> _available;
+    std::deque<std::pair<uint32_t, uint64_t>> _released; // texture index and the frame it was released on
+
+    // image the pool's textures are created from and that subsequent images must match
+    vsg::ref_ptr<vsg::Data> _template;
+
+    // images acquired before the DescriptorImage is created, used as the initial contents of their textures
+    std::vector<vsg::ref_ptr<vsg::Data>> _initialImages;
+
+    vsg::ImageInfoList _imageInfos;
+};
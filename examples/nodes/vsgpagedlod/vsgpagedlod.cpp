@@ -7,7 +7,8 @@
 #include <iostream>
 #include <thread>
 
-#include "TileReader.h"
+#include "TileBaker.h"
+#include "TilePrefetcher.h"
 
 int main(int argc, char** argv)
 {
@@ -50,10 +51,36 @@ int main(int argc, char** argv)
         if (arguments.read("--rgb")) options->mapRGBtoRGBAHint = false;
         arguments.read("--file-cache", options->fileCache);
         bool osgEarthStyleMouseButtons = arguments.read({"--osgearth", "-e"});
+        bool prefetch = arguments.read("--prefetch");
+        auto prefetchFrames = arguments.value(30u, "--prefetch-frames");
 
         uint32_t numOperationThreads = 0;
         if (arguments.read("--ot", numOperationThreads)) options->operationThreads = vsg::OperationThreads::create(numOperationThreads);
 
+        // image and terrain layer path templates, with {x}, {y} and {z} replaced by the tile position, which may be a local file path
+        arguments.read("--image", tileReader->imageLayer);
+        arguments.read("--terrain", tileReader->terrainLayer);
+        arguments.read("--skirt", tileReader->skirtRatio);
+        if (arguments.read("--compress")) tileReader->imageCompressor = ImageCompressor::create();
+        auto maxPagedLOD = arguments.value(0, "--maxPagedLOD");
+        auto maxConcurrentReads = arguments.value(0u, "--max-reads");
+        auto numPoolTextures = arguments.value(0u, "--texture-pool");
+        auto statsInterval = arguments.value(0.0, "--stats");
+
+        // bake the tiles down to the specified level into a directory, or view tiles previously baked into a directory
+        vsg::Path bakeDirectory;
+        uint32_t bakeLevel = 0;
+        arguments.read("--bake", bakeDirectory, bakeLevel);
+        auto bakedDirectory = arguments.value(vsg::Path(), "--baked");
+        if (numPoolTextures > 0 && !bakeDirectory.empty())
+        {
+            std::cout << "--texture-pool can't be used with --bake, pooled textures are only available to the viewer that created them." << std::endl;
+            return 1;
+        }
+        if (numPoolTextures > 0) tileReader->texturePool = TileTexturePool::create(numPoolTextures);
+
+        auto tileCacheDirectory = arguments.value(std::string(), "--tile-cache");
+
         if (arguments.read("--osm"))
         {
             // setup OpenStreetMap settings
@@ -88,11 +115,44 @@ int main(int argc, char** argv)
 
         if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
+        // the cache is opened once all the TileReader settings are final, so tiles cached with different settings are discarded
+        if (!tileCacheDirectory.empty())
+        {
+            tileReader->tileCache = TileCache::create(tileCacheDirectory, tileReader->computeCacheSignature());
+            if (!tileReader->tileCache->valid())
+            {
+                std::cout << "Warning: unable to open tile cache : " << tileCacheDirectory << std::endl;
+                tileReader->tileCache = {};
+            }
+        }
+
         // initial the state that will be shared between tiles.
         tileReader->init();
 
-        // load the root tile.
-        auto vsg_scene = vsg::read_cast<vsg::Node>("root.tile", options);
+        if (!bakeDirectory.empty())
+        {
+            auto tileBaker = TileBaker::create(tileReader, options, bakeDirectory, bakeLevel);
+            if (options->operationThreads) tileBaker->operationThreads = options->operationThreads;
+
+            bool result = tileBaker->bake();
+
+            tileBaker->report(std::cout);
+            tileReader->stats->report(std::cout);
+            return result ? 0 : 1;
+        }
+
+        // load the root tile, either the one previously baked or the one created by the TileReader.
+        vsg::ref_ptr<vsg::Node> vsg_scene;
+        if (!bakedDirectory.empty())
+        {
+            // the baked PagedLOD filenames are relative to the bake directory
+            options->paths.insert(options->paths.begin(), bakedDirectory);
+            vsg_scene = vsg::read_cast<vsg::Node>("root.vsgb", options);
+        }
+        else
+        {
+            vsg_scene = vsg::read_cast<vsg::Node>("root.tile", options);
+        }
         if (!vsg_scene) return 1;
 
         if (!outputFilename.empty())
@@ -112,6 +172,14 @@ int main(int argc, char** argv)
 
         viewer->addWindow(window);
 
+        if (tileReader->texturePool)
+        {
+            // tiles paged in copy their imagery into the pool's textures via the CopyAndReleaseImage command, which is added to the CommandGraph below
+            auto memoryBufferPools = vsg::MemoryBufferPools::create("Staging_MemoryBufferPool", window->getOrCreateDevice());
+            tileReader->texturePool->copyImages = vsg::CopyAndReleaseImage::create(memoryBufferPools);
+            viewer->addEventHandler(tileReader->texturePool);
+        }
+
         // compute the bounds of the scene graph to help position camera
         vsg::ComputeBounds computeBounds;
         vsg_scene->accept(computeBounds);
@@ -203,6 +271,20 @@ int main(int argc, char** argv)
             viewer->addEventHandler(vsg::AnimationPathHandler::create(camera, animationPath, viewer->start_point()));
         }
 
+        if (maxConcurrentReads > 0)
+        {
+            tileReader->tileScheduler = TileScheduler::create(camera, maxConcurrentReads);
+            viewer->addEventHandler(tileReader->tileScheduler);
+        }
+
+        vsg::ref_ptr<TilePrefetcher> tilePrefetcher;
+        if (prefetch && ellipsoidModel)
+        {
+            tilePrefetcher = TilePrefetcher::create(tileReader, lookAt, options);
+            tilePrefetcher->numFramesAhead = prefetchFrames;
+            viewer->addEventHandler(tilePrefetcher);
+        }
+
         // if required pre load specific number of PagedLOD levels.
         if (loadLevels > 0)
         {
@@ -217,10 +299,22 @@ int main(int argc, char** argv)
         }
 
         auto commandGraph = vsg::createCommandGraphForView(window, camera, vsg_scene);
+        if (tileReader->texturePool) commandGraph->children.insert(commandGraph->children.begin(), tileReader->texturePool->copyImages);
         viewer->assignRecordAndSubmitTaskAndPresentation({commandGraph});
 
         viewer->compile();
 
+        if (maxPagedLOD > 0)
+        {
+            // set targetMaxNumPagedLODWithHighResSubgraphs after Viewer::compile() as it will assign any DatabasePager if required.
+            for (auto& task : viewer->recordAndSubmitTasks)
+            {
+                if (task->databasePager) task->databasePager->targetMaxNumPagedLODWithHighResSubgraphs = maxPagedLOD;
+            }
+        }
+
+        auto lastStatsReport = vsg::clock::now();
+
         // rendering main loop
         while (viewer->advanceToNextFrame() && (numFrames < 0 || (numFrames--) > 0))
         {
@@ -232,14 +326,23 @@ int main(int argc, char** argv)
             viewer->recordAndSubmit();
 
             viewer->present();
-        }
 
-        {
-            std::scoped_lock<std::mutex> lock(tileReader->statsMutex);
-            std::cout << "numOperationThreads = " << numOperationThreads << std::endl;
-            std::cout << "numTilesRead = " << tileReader->numTilesRead << std::endl;
-            std::cout << "average TimeReadingTiles = " << (tileReader->totalTimeReadingTiles / static_cast<double>(tileReader->numTilesRead)) << std::endl;
+            // report the tile load stats every statsInterval seconds
+            if (statsInterval > 0.0 && std::chrono::duration<double>(viewer->getFrameStamp()->time - lastStatsReport).count() >= statsInterval)
+            {
+                tileReader->stats->report(std::cout);
+                lastStatsReport = viewer->getFrameStamp()->time;
+            }
         }
+
+        std::cout << "numOperationThreads = " << numOperationThreads << std::endl;
+        tileReader->stats->report(std::cout);
+
+        if (tileReader->tileCache) tileReader->tileCache->report(std::cout);
+        if (tileReader->imageCompressor) tileReader->imageCompressor->report(std::cout);
+        if (tilePrefetcher) tilePrefetcher->report(std::cout);
+        if (tileReader->tileScheduler) tileReader->tileScheduler->report(std::cout);
+        if (tileReader->texturePool) tileReader->texturePool->report(std::cout);
     }
     catch (const vsg::Exception& ve)
     {
@@ -6,9 +6,90 @@
 
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
 #include <thread>
 
+// Bounded stage of the load, compile and merge pipeline. A request entering a full stage blocks the thread handing it on
+// until a request leaves the stage, so the upstream stage stalls rather than piling up work the downstream stage can't absorb.
+struct PipelineStage
+{
+    PipelineStage(const char* in_name, uint32_t in_capacity) :
+        name(in_name),
+        capacity(in_capacity) {}
+
+    const char* name;
+    uint32_t capacity; // 0 for unbounded
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t depth = 0;
+
+    // queue depth metrics
+    uint32_t maxDepth = 0;
+    uint64_t numEntered = 0;
+    uint64_t numStalls = 0;
+    double stallTime = 0.0; // milliseconds
+
+    // enter the stage if there is room, without blocking
+    bool tryEnter()
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+        if (capacity > 0 && depth >= capacity) return false;
+
+        entered();
+        return true;
+    }
+
+    // block until there is room to enter the stage, returns false if status becomes inactive while waiting
+    bool enter(const vsg::ActivityStatus& status)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (capacity > 0 && depth >= capacity)
+        {
+            ++numStalls;
+            auto start = vsg::clock::now();
+
+            // wake periodically to check the status so that blocked threads are released when the viewer is closed
+            while (depth >= capacity)
+            {
+                if (!status.active()) return false;
+                cv.wait_for(lock, std::chrono::milliseconds(100));
+            }
+
+            stallTime += std::chrono::duration<double, std::chrono::milliseconds::period>(vsg::clock::now() - start).count();
+        }
+
+        entered();
+        return true;
+    }
+
+    void leave()
+    {
+        {
+            std::scoped_lock<std::mutex> lock(mutex);
+            --depth;
+        }
+        cv.notify_one();
+    }
+
+    void report(std::ostream& out)
+    {
+        std::scoped_lock<std::mutex> lock(mutex);
+        out << "    " << name << " : capacity = " << capacity << ", depth = " << depth << ", max depth = " << maxDepth << ", entered = " << numEntered;
+        out << ", stalls = " << numStalls << ", stall time = " << stallTime << "ms" << std::endl;
+    }
+
+protected:
+    void entered()
+    {
+        ++depth;
+        ++numEntered;
+        maxDepth = std::max(maxDepth, depth);
+    }
+};
+
 class DynamicLoadAndCompile : public vsg::Inherit<vsg::Object, DynamicLoadAndCompile>
 {
 public:
@@ -18,6 +99,21 @@ public:
     vsg::ref_ptr<vsg::OperationThreads> compileThreads;
     vsg::ref_ptr<vsg::OperationQueue> mergeQueue;
 
+    // bounds on the number of requests being loaded, being compiled, and compiled but waiting to be merged.
+    // a request's slot in the next stage is reserved before it leaves the current one, and a merge slot is reserved before
+    // compiling, so no GPU resources are allocated for subgraphs the merge stage has no room for.
+    PipelineStage loadStage{"load", 12};
+    PipelineStage compileStage{"compile", 2};
+    PipelineStage mergeStage{"merge", 4};
+
+    // maximum number of subgraphs merged each frame, 0 for unlimited
+    uint32_t maxMergesPerFrame = 0;
+
+    // requests waiting for room in the load stage
+    std::mutex mutex_pendingLoads;
+    std::deque<vsg::ref_ptr<vsg::Operation>> pendingLoads;
+    uint32_t maxPendingLoads = 0;
+
     std::mutex mutex_compileTraversals;
     std::list<vsg::ref_ptr<vsg::CompileTraversal>> compileTraversals;
 
@@ -86,12 +182,35 @@ public:
     void loadRequest(const vsg::Path& filename, vsg::ref_ptr<vsg::Group> attachmentPoint, vsg::ref_ptr<vsg::Options> options)
     {
         auto request = Request::create(filename, attachmentPoint, options);
-        loadThreads->add(LoadOperation::create(request, vsg::observer_ptr<DynamicLoadAndCompile>(this)));
+
+        // loadRequest() is called from the main thread, which also does the merging, so rather than blocking when the load stage is full the request is queued until there is room
+        {
+            std::scoped_lock lock(mutex_pendingLoads);
+            pendingLoads.push_back(LoadOperation::create(request, vsg::observer_ptr<DynamicLoadAndCompile>(this)));
+            maxPendingLoads = std::max(maxPendingLoads, static_cast<uint32_t>(pendingLoads.size()));
+        }
+
+        admitLoads();
+    }
+
+    // move pending requests into the load stage while it has room
+    void admitLoads()
+    {
+        std::scoped_lock lock(mutex_pendingLoads);
+        while (!pendingLoads.empty() && loadStage.tryEnter())
+        {
+            loadThreads->add(pendingLoads.front());
+            pendingLoads.pop_front();
+        }
     }
 
-    void compileRequest(vsg::ref_ptr<Request> request)
+    // hand a loaded request on to the compile thread, blocking the calling load thread while the compile stage is full
+    bool compileRequest(vsg::ref_ptr<Request> request)
     {
+        if (!compileStage.enter(*status)) return false;
+
         compileThreads->add(CompileOperation::create(request, vsg::observer_ptr<DynamicLoadAndCompile>(this)));
+        return true;
     }
 
     void mergeRequest(vsg::ref_ptr<Request> request)
@@ -127,11 +246,25 @@ public:
 
     void merge()
     {
+        uint32_t numMerged = 0;
         vsg::ref_ptr<vsg::Operation> operation;
-        while (operation = mergeQueue->take())
+        while ((maxMergesPerFrame == 0 || numMerged < maxMergesPerFrame) && (operation = mergeQueue->take()))
         {
             operation->run();
+            ++numMerged;
+        }
+    }
+
+    void report(std::ostream& out)
+    {
+        out << "DynamicLoadAndCompile queue depths" << std::endl;
+        {
+            std::scoped_lock lock(mutex_pendingLoads);
+            out << "    pending : depth = " << pendingLoads.size() << ", max depth = " << maxPendingLoads << std::endl;
         }
+        loadStage.report(out);
+        compileStage.report(out);
+        mergeStage.report(out);
     }
 };
 
@@ -157,8 +290,16 @@ void DynamicLoadAndCompile::LoadOperation::run()
 
         std::cout << "Loaded " << request->filename << std::endl;
 
-        dynamicLoadAndCompile->compileRequest(request);
+        if (!dynamicLoadAndCompile->compileRequest(request)) std::cout << "Dropped " << request->filename << std::endl;
     }
+    else
+    {
+        std::cout << "Failed to load " << request->filename << std::endl;
+    }
+
+    // only leave the load stage once the request has a place in the compile stage, then take on any pending requests
+    dynamicLoadAndCompile->loadStage.leave();
+    dynamicLoadAndCompile->admitLoads();
 }
 
 void DynamicLoadAndCompile::CompileOperation::run()
@@ -166,7 +307,8 @@ void DynamicLoadAndCompile::CompileOperation::run()
     vsg::ref_ptr<DynamicLoadAndCompile> dynamicLoadAndCompile(dlac);
     if (!dynamicLoadAndCompile) return;
 
-    if (request->loaded)
+    // reserve a place in the merge stage before compiling so the compiled GPU resources are never left waiting on a full merge queue
+    if (request->loaded && dynamicLoadAndCompile->mergeStage.enter(*dynamicLoadAndCompile->status))
     {
         std::cout << "Compiling " << request->filename << std::endl;
 
@@ -197,6 +339,8 @@ void DynamicLoadAndCompile::CompileOperation::run()
 
         dynamicLoadAndCompile->addCompileTraversal(compileTraversal);
     }
+
+    dynamicLoadAndCompile->compileStage.leave();
 }
 
 void DynamicLoadAndCompile::MergeOperation::run()
@@ -204,6 +348,9 @@ void DynamicLoadAndCompile::MergeOperation::run()
     std::cout << "Merging " << request->filename << std::endl;
 
     request->attachmentPoint->addChild(request->loaded);
+
+    vsg::ref_ptr<DynamicLoadAndCompile> dynamicLoadAndCompile(dlac);
+    if (dynamicLoadAndCompile) dynamicLoadAndCompile->mergeStage.leave();
 }
 
 int main(int argc, char** argv)
@@ -233,6 +380,10 @@ int main(int argc, char** argv)
         arguments.read("--screen", windowTraits->screenNum);
         arguments.read("--display", windowTraits->display);
         auto numFrames = arguments.value(-1, "-f");
+        auto maxLoads = arguments.value(12u, "--max-loads");
+        auto maxCompiles = arguments.value(2u, "--max-compiles");
+        auto maxMerges = arguments.value(4u, "--max-merges");
+        auto mergesPerFrame = arguments.value(0u, "--merges-per-frame");
 
         // provide setting of the resource hints on the command line
         vsg::ref_ptr<vsg::ResourceHints> resourceHints;
@@ -298,6 +449,10 @@ int main(int argc, char** argv)
         // create the DynamicLoadAndCompile object that manages loading, compile and merging of new objects.
         // Pass in window and viewportState to help initialize CompilTraversals
         auto dynamicLoadAndCompile = DynamicLoadAndCompile::create(viewer, viewer->status);
+        dynamicLoadAndCompile->loadStage.capacity = maxLoads;
+        dynamicLoadAndCompile->compileStage.capacity = maxCompiles;
+        dynamicLoadAndCompile->mergeStage.capacity = maxMerges;
+        dynamicLoadAndCompile->maxMergesPerFrame = mergesPerFrame;
 
         // build the scene graph attachments points to place all of the loaded models at.
         for (int i = 1; i < argc; ++i)
@@ -325,6 +480,8 @@ int main(int argc, char** argv)
 
             viewer->present();
         }
+
+        dynamicLoadAndCompile->report(std::cout);
     }
     catch (const vsg::Exception& ve)
     {